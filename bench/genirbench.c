@@ -0,0 +1,46 @@
+/** Generate a large Cone program, for benchmarking the IR's memory and pass times
+ * @file
+ *
+ * Usage: genirbench [count] > irbench.cone
+ *
+ * Writes a program of count (default 3000) groups. Each group is a struct with
+ * four fields and three methods, and a function that builds one, calls its
+ * methods and the previous group's function. So the program exercises the
+ * things IR references are held in: namespaces, method and property lists,
+ * node lists, name uses and their declarations.
+ * The program runs, returning a small number.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 3000;
+    int i;
+
+    if (count < 1) {
+        fprintf(stderr, "Usage: genirbench [count]\n");
+        return 1;
+    }
+    for (i = 0; i < count; ++i) {
+        printf("struct Pt%d\n", i);
+        printf("  x i32\n  y i32\n  z i32\n  w i32\n");
+        printf("  fn sum() i32\n    x + y + z + w\n");
+        printf("  fn scale(k i32) i32\n    (x + y) * k - z\n");
+        printf("  fn mix(a i32, b i32) i32\n    if a > b\n      x * a\n    else\n      y * b + w\n");
+        printf("\n");
+        printf("fn use%d(n i32) i32\n", i);
+        printf("  mut p = Pt%d[n, n + %d, n - 1, 2]\n", i, i % 7);
+        printf("  mut t = p.sum()\n");
+        printf("  if t > 10\n    t = t - p.scale(2)\n");
+        printf("  t = t + p.mix(t, n)\n");
+        if (i > 0)
+            printf("  if n > 0\n    t = t + use%d(n - 1)\n", i - 1);
+        printf("  t & 15\n\n");
+    }
+    printf("fn main() i32\n  use%d(2)\n", count - 1);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#!/bin/sh
+# Compare the IR's memory use and pass times of two conec builds, on a large
+# generated program (see genirbench.c). Typically the two are a default build
+# and one configured with -DCONE_COMPRESSED_IR=ON:
+#
+#   bench/irbench.sh build/conec build-compressed/conec [count] [runs]
+#
+# For each build, prints the arena memory (live and peak, from --stats), the
+# peak RSS (where /usr/bin/time can measure it) and the fastest of runs (default 5)
+# name resolution and type check times. Code generation is not measured:
+# the program is compiled with -d (no optimization), and its output discarded.
+
+set -e
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 <conec> <other conec> [count] [runs]" >&2
+    exit 1
+fi
+count=${3:-3000}
+runs=${4:-5}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+cc -O2 -o "$dir/genirbench" "$(dirname "$0")/genirbench.c"
+"$dir/genirbench" "$count" > "$dir/irbench.cone"
+
+for conec in "$1" "$2"; do
+    rss=
+    i=0
+    while [ $i -lt "$runs" ]; do
+        if [ -x /usr/bin/time ]; then
+            /usr/bin/time -f "rss %M" "$conec" -d --stats -o "$dir" "$dir/irbench.cone" > /dev/null 2> "$dir/stats.$i"
+        else
+            "$conec" -d --stats -o "$dir" "$dir/irbench.cone" > /dev/null 2> "$dir/stats.$i"
+        fi
+        i=$((i + 1))
+    done
+    cat "$dir"/stats.* | awk -v conec="$conec" '
+        $1 == "nameres" && (nr == "" || $2 < nr) { nr = $2 }
+        $1 == "typecheck" && (tc == "" || $2 < tc) { tc = $2 }
+        $1 == "Memory:" { live = $2; peak = $5 }
+        $1 == "rss" && $2 > rss { rss = $2 }
+        END {
+            printf "%s\n  arena: %s kb live, %s kb peak", conec, live, peak
+            if (rss != "") printf "; peak RSS %s kb", rss
+            printf "\n  nameres %s ms, typecheck %s ms\n", nr, tc
+        }'
+    rm -f "$dir"/stats.*
+done
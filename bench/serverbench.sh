@@ -0,0 +1,57 @@
+#!/bin/sh
+# Compare compiling a program with conec directly, and with conecc handing it
+# to a warm compile server (conec --server), over many compiles in a row:
+#
+#   bench/serverbench.sh build/conec hello.cone [count] [runs]
+#
+# Prints the fastest of runs (default 3) total times for count (default 40)
+# compiles each way, and so what the server saves (or costs) per compile.
+# Compiles are run with -d (no optimization), the way an editor or build tool
+# doing many small compiles would, so startup is a good part of each.
+
+set -e
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 <conec> <source file> [count] [runs]" >&2
+    exit 1
+fi
+conec=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+conecc=$(dirname "$conec")/conecc
+src=$2
+count=${3:-40}
+runs=${4:-3}
+dir=$(mktemp -d)
+sock="$dir/conec.sock"
+
+"$conec" --server="$sock" 2> "$dir/server.log" &
+server=$!
+trap 'kill $server 2> /dev/null; rm -rf "$dir"' EXIT
+while [ ! -S "$sock" ]; do sleep 0.1; done
+
+# Print the milliseconds taken by count compiles by a compiler (conec or conecc)
+compiles() {
+    start=$(date +%s%N)
+    i=0
+    while [ $i -lt "$count" ]; do
+        "$1" -d -o "$dir" "$src" > /dev/null 2>&1
+        i=$((i + 1))
+    done
+    echo $((($(date +%s%N) - start) / 1000000))
+}
+
+# Print the fastest of runs
+fastest() {
+    best=
+    i=0
+    while [ $i -lt "$runs" ]; do
+        ms=$("$@")
+        if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then best=$ms; fi
+        i=$((i + 1))
+    done
+    echo "$best"
+}
+
+direct=$(fastest compiles "$conec")
+export CONE_SERVER="$sock"
+served=$(fastest compiles "$conecc")
+echo "$count compiles of $src: direct $direct ms, server $served ms"
+echo "per compile: direct $((direct * 1000 / count)) us, server $((served * 1000 / count)) us"
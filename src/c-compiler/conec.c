@@ -11,15 +11,25 @@
 #include "ir/nametbl.h"
 #include "ir/ir.h"
 #include "shared/error.h"
+#include "shared/cache.h"
+#include "shared/digest.h"
+#include "shared/server.h"
+#include "shared/stats.h"
+#include "shared/trace.h"
 #include "parser/lexer.h"
+#include "parser/lexscan.h"
 #include "parser/parser.h"
 #include "genllvm/genllvm.h"
 
+#include <llvm/Config/llvm-config.h>
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <assert.h>
 
-clock_t startTime;
+double startTime;
 
 // Run all semantic analysis passes against the AST/IR (after parse and before gen)
 void doAnalysis(ModuleNode **mod) {
@@ -33,6 +43,7 @@ void doAnalysis(ModuleNode **mod) {
     // Resolve all name uses to their appropriate declaration
     // Note: Some nodes may be replaced (e.g., 'a' to 'self.a')
     pstate.pass = NameResolution;
+    statsPhase(StatsNameRes);
     inodeWalk(&pstate, (INode**)mod);
     if (errors)
         return;
@@ -40,22 +51,116 @@ void doAnalysis(ModuleNode **mod) {
     // Apply syntactic sugar, and perform type inference/check
     // Note: Some nodes may be lowered, injected or replaced
     pstate.pass = TypeCheck;
+    statsPhase(StatsTypeCheck);
     inodeWalk(&pstate, (INode**)mod);
 }
 
-int main(int argc, char **argv) {
+// Identify this build of the compiler: its release, the LLVM it was built against,
+// and the contents of its executable, so that any rebuild of it counts as a different
+// compiler. Cached object files and incremental fingerprints only match the same build.
+char *conecBuildId() {
+    static char id[33];
+    if (*id == '\0') {
+        Digest digest;
+        char *exe = fileExePath();
+        digestInit(&digest);
+        digestStr(&digest, CONE_RELEASE);
+        digestStr(&digest, LLVM_VERSION_STRING);
+        if (!exe || !digestFile(&digest, exe))
+            digestStr(&digest, exe);    // Short of its contents, its name at least
+        digestHex(&digest, id);
+    }
+    return id;
+}
+
+// Turn on the output cache, if requested, hashing in all inputs except the source files.
+// (Those are hashed as the lexer loads them.)
+void conecCacheSetup(ConeOptions *opt) {
+    char *dir = opt->cache_dir;
+    char *home;
+
+    // Only compiles whose sole output is a single object file are cached
+    if (!opt->cache || opt->print_ir || opt->print_llvmir || opt->print_asm
+        || opt->run || opt->units > 1 || opt->docs)
+        return;
+
+    // Default cache folder
+    if (!dir && !(dir = getenv("CONE_CACHE_DIR"))) {
+#ifdef _WIN32
+        char *subdir = "\\cone";
+        home = getenv("LOCALAPPDATA");
+#else
+        char *subdir = "/.cache/cone";
+        home = getenv("HOME");
+#endif
+        if (!home)
+            return;
+        dir = memAllocStr(home, strlen(home) + strlen(subdir));
+        strcat(dir, subdir);
+    }
+    if (!cacheInit(dir, opt->cache_size))
+        return;
+
+    cacheHashStr(conecBuildId());
+    cacheHashStr(opt->triple);
+    cacheHashStr(opt->cpu);
+    cacheHashStr(opt->features);
+    cacheHashBytes(&opt->ptrsize, sizeof(opt->ptrsize));
+    cacheHashBytes(&opt->release, sizeof(opt->release));
+    cacheHashBytes(&opt->optlevel, sizeof(opt->optlevel));
+    cacheHashBytes(&opt->sizelevel, sizeof(opt->sizelevel));
+    cacheHashBytes(&opt->pic, sizeof(opt->pic));
+    cacheHashBytes(&opt->wasm, sizeof(opt->wasm));
+    cacheHashBytes(&opt->library, sizeof(opt->library));
+    cacheHashBytes(&opt->strip_debug, sizeof(opt->strip_debug));
+    cacheHashBytes(&opt->extfun, sizeof(opt->extfun));
+    cacheHashBytes(&opt->simple_builtin, sizeof(opt->simple_builtin));
+}
+
+// Once all source files are loaded, reuse a cached object file if there is one.
+// Returns 1 on a hit.
+int conecCacheHit(GenState *gen, ModuleNode *mod) {
+    char *obj;
+    size_t size;
+    if (!cacheActive() || !(obj = cacheLookup("obj", &size)))
+        return 0;
+    if (!fileWrite(genlObjPath(gen, inodeSrcFile(mod)->fname), obj, size))
+        return 0;
+    return 1;
+}
+
+int conecCompile(int argc, char **argv);
+
+// Warm up everything every compile needs, then serve compile requests forever
+void conecServe(ConeOptions *opt) {
+    GenState gen;
+    conecBuildId();
+    genSetup(&gen, opt);
+    genWarm(&gen);
+    parseStd(opt->ptrsize);
+    serverRun(opt->server, conecCompile);
+}
+
+// Compile a program, as specified by the command line. Returns the exit code.
+int conecCompile(int argc, char **argv) {
     ConeOptions coneopt;
     GenState gen;
     ModuleNode *modnode;
     int ok;
 
-    // Start measuring processing time for compilation
-    startTime = clock();
+    // Start measuring (wall-clock) time for compilation, which includes any forked jobs
+    startTime = statsWallClock();
 
     // Get compiler's options from passed arguments
     ok = coneOptSet(&coneopt, &argc, argv);
     if (ok <= 0)
         exit(ok == 0 ? 0 : ExitOpts);
+    if (coneopt.server)
+        conecServe(&coneopt);
+    if (coneopt.print_stats)
+        statsInit();
+    if (coneopt.time_trace)
+        traceInit(coneopt.time_trace);
     if (argc < 2)
         errorExit(ExitOpts, "Specify a Cone program to compile.");
     coneopt.srcpath = argv[1];
@@ -63,22 +168,38 @@ int main(int argc, char **argv) {
 
     // We set up generation early because we need target info, e.g.: pointer size
     genSetup(&gen, &coneopt);
+    conecCacheSetup(&coneopt);
 
     // Parse source file, do semantic analysis, and generate code
     modnode = parsePgm(&coneopt);
-    if (errors == 0) {
+    if (errors == 0 && !conecCacheHit(&gen, modnode)) {
         doAnalysis(&modnode);
         if (errors == 0) {
             if (coneopt.print_ir)
                 inodePrint(coneopt.output, coneopt.srcpath, (INode*)modnode);
             genmod(&gen, modnode);
             genClose(&gen);
+            if (errors == 0 && cacheActive() && !coneopt.obj_stdout)
+                cacheStoreFile("obj", genlObjPath(&gen, inodeSrcFile(modnode)->fname));
         }
     }
 
     // Close up everything necessary
+    statsReport(coneopt.stats_json);
+    traceClose();
     errorSummary();
+
+    // Run the compiled program, if requested, passing along its arguments
+    if (coneopt.run)
+        return genlJitRun(&gen, argc - 1, &argv[1]);
 #ifdef _DEBUG
     getchar();    // Hack for VS debugging
 #endif
+    return ExitSuccess;
+}
+
+int main(int argc, char **argv) {
+    // Choose the lexer's scanners for this CPU, before any thread lexes
+    lexScanInit();
+    return conecCompile(argc, argv);
 }
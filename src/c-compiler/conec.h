@@ -41,4 +41,7 @@
 #define CONE_RELEASE    CONE_VERSION "." CONE_VERSION_RELEASE
 #define CONE_COPYRIGHT    CONE_RELEASE "  Copyright (C) 2017-2018 Jonathan Goodwin"
 
+// Identify this build of the compiler, as 32 hex digits (see conec.c)
+char *conecBuildId();
+
 #endif
@@ -0,0 +1,45 @@
+/** Compile server client program
+ * @file
+ *
+ * conecc takes the same command line as conec. It hands the compile over to the
+ * warm compile server at $CONE_SERVER (see shared/server.c), or, if none answers,
+ * runs the conec beside it to compile locally.
+ *
+ * It is a separate program because most of the time a small compile takes
+ * goes to loading LLVM, which conecc (unlike conec) never does.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "shared/server.h"
+#include "shared/error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+    char *server = getenv("CONE_SERVER");
+    char *slash = strrchr(argv[0], '/');
+    char conec[4096];
+    int status;
+
+    // Hand the compile over to a warm compile server, if one is listening
+    if (server && serverRequest(server, argc, argv, &status))
+        return status;
+
+    // Otherwise run conec from this program's folder (or the PATH) instead
+    if (slash && (size_t)(slash - argv[0]) + sizeof("/conec") <= sizeof(conec)) {
+        sprintf(conec, "%.*s/conec", (int)(slash - argv[0]), argv[0]);
+        argv[0] = conec;
+        execv(conec, argv);
+    }
+    else {
+        argv[0] = "conec";
+        execvp("conec", argv);
+    }
+    fprintf(stderr, "Error: Could not run conec\n");
+    return ExitError;
+}
@@ -8,6 +8,7 @@
 #include "conec.h"
 #include "coneopts.h"
 #include "shared/options.h"
+#include "shared/memory.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -19,6 +20,7 @@ enum
     OPT_VERSION,
     OPT_HELP,
     OPT_DEBUG,
+    OPT_OPTLEVEL,
     OPT_BUILDFLAG,
     OPT_STRIP,
     OPT_PATHS,
@@ -29,6 +31,7 @@ enum
     OPT_NOPIC,
     OPT_DOCS,
     OPT_DOCS_PUBLIC,
+    OPT_RUN,
 
     OPT_SAFE,
     OPT_CPU,
@@ -36,8 +39,19 @@ enum
     OPT_WASM,
     OPT_TRIPLE,
     OPT_STATS,
+    OPT_STATS_JSON,
+    OPT_TIME_TRACE,
+    OPT_ARENA_SIZE,
+    OPT_STR_ARENA_SIZE,
     OPT_LINK_ARCH,
     OPT_LINKER,
+    OPT_JOBS,
+    OPT_UNITS,
+    OPT_CACHE,
+    OPT_INCREMENTAL,
+    OPT_CACHE_DIR,
+    OPT_CACHE_SIZE,
+    OPT_SERVER,
 
     OPT_VERBOSE,
     OPT_IR,
@@ -63,6 +77,7 @@ static opt_arg_t args[] =
     { "version", 'v', OPT_ARG_NONE, OPT_VERSION },
     { "help", 'h', OPT_ARG_NONE, OPT_HELP },
     { "debug", 'd', OPT_ARG_NONE, OPT_DEBUG },
+    { "opt", 'O', OPT_ARG_REQUIRED, OPT_OPTLEVEL },
     { "define", 'D', OPT_ARG_REQUIRED, OPT_BUILDFLAG },
     { "strip", 's', OPT_ARG_NONE, OPT_STRIP },
     { "path", 'p', OPT_ARG_REQUIRED, OPT_PATHS },
@@ -73,6 +88,7 @@ static opt_arg_t args[] =
     { "nopic", '\0', OPT_ARG_NONE, OPT_NOPIC },
     { "docs", 'g', OPT_ARG_NONE, OPT_DOCS },
     { "docs-public", '\0', OPT_ARG_NONE, OPT_DOCS_PUBLIC },
+    { "run", 'r', OPT_ARG_NONE, OPT_RUN },
 
     { "safe", '\0', OPT_ARG_OPTIONAL, OPT_SAFE },
     { "cpu", '\0', OPT_ARG_REQUIRED, OPT_CPU },
@@ -80,8 +96,19 @@ static opt_arg_t args[] =
     { "wasm", '\0', OPT_ARG_NONE, OPT_WASM },
     { "triple", '\0', OPT_ARG_REQUIRED, OPT_TRIPLE },
     { "stats", '\0', OPT_ARG_NONE, OPT_STATS },
+    { "stats-json", '\0', OPT_ARG_REQUIRED, OPT_STATS_JSON },
+    { "time-trace", '\0', OPT_ARG_REQUIRED, OPT_TIME_TRACE },
+    { "arena-size", '\0', OPT_ARG_REQUIRED, OPT_ARENA_SIZE },
+    { "str-arena-size", '\0', OPT_ARG_REQUIRED, OPT_STR_ARENA_SIZE },
     { "link-arch", '\0', OPT_ARG_REQUIRED, OPT_LINK_ARCH },
     { "linker", '\0', OPT_ARG_REQUIRED, OPT_LINKER },
+    { "jobs", 'j', OPT_ARG_REQUIRED, OPT_JOBS },
+    { "units", '\0', OPT_ARG_REQUIRED, OPT_UNITS },
+    { "cache", '\0', OPT_ARG_NONE, OPT_CACHE },
+    { "incremental", 'i', OPT_ARG_NONE, OPT_INCREMENTAL },
+    { "cache-dir", '\0', OPT_ARG_REQUIRED, OPT_CACHE_DIR },
+    { "cache-size", '\0', OPT_ARG_REQUIRED, OPT_CACHE_SIZE },
+    { "server", '\0', OPT_ARG_REQUIRED, OPT_SERVER },
 
     { "verbose", 'V', OPT_ARG_REQUIRED, OPT_VERBOSE },
     { "ir", '\0', OPT_ARG_NONE, OPT_IR },
@@ -110,7 +137,9 @@ static void usage()
         "Options:\n"
         "  --version, -v   Print the version of the compiler and exit.\n"
         "  --help, -h      Print this help text and exit.\n"
-        "  --debug, -d     Don't optimise the output.\n"
+        "  --debug, -d     Don't optimise the output, and emit debug info.\n"
+        "  --opt, -O       Set the optimization level.\n"
+        "    =level        0, 1, 2 (default), 3, s (size) or z (smallest size).\n"
         "  --define, -D    Define the specified build flag.\n"
         "    =name\n"
         "  --strip, -s     Strip debug info.\n"
@@ -118,13 +147,34 @@ static void usage()
         "    =path         Used to find packages and libraries.\n"
         "  --output, -o    Write output to this directory.\n"
         "    =path         Defaults to the current directory.\n"
+        "                  --output=- writes the object file to stdout.\n"
         "  --library, -l   Generate a C-API compatible static library.\n"
         "  --runtimebc     Compile with the LLVM bitcode file for the runtime.\n"
         "  --wasm          Compile for WebAssembly target.\n"
         "  --pic           Compile using position independent code.\n"
+        "  --jobs, -j      Parse source files, and generate function bodies, in parallel.\n"
+        "                  Function bodies are generated in parallel only in release\n"
+        "                  builds, as debug info is not carried across jobs.\n"
+        "                  Optimizing and emitting stay serial: see --units for that.\n"
+        "    =count        Number of worker jobs. Defaults to 1.\n"
+        "  --units         Split output into separately optimized object files.\n"
+        "    =count        Emits name.0.o to name.<count-1>.o. Defaults to 1.\n"
+        "  --cache         Reuse the object file from an identical earlier compile.\n"
+        "  --incremental, -i  Regenerate only functions changed since the last build.\n"
+        "                  Keeps name.incbc and name.incfp in the output folder.\n"
+        "  --cache-dir     Use (and turn on) this folder for cached object files.\n"
+        "    =path         Defaults to $CONE_CACHE_DIR or ~/.cache/cone.\n"
+        "  --cache-size    Evict least recently used cached files beyond this size.\n"
+        "    =megabytes    Defaults to 512.\n"
+        "  --server        Serve compile requests on this local socket, with warm state.\n"
+        "    =path         conecc hands its compiles to the server at $CONE_SERVER.\n"
+        "                  Other options set the target and settings kept warm.\n"
+        "                  Saves time only for small compiles, run one after another.\n"
         "  --nopic         Don't compile using position independent code.\n"
         "  --docs, -g      Generate code documentation.\n"
         "  --docs-public   Generate code documentation for public types only.\n"
+        "  --run, -r       Compile and run the program in-process, without object files.\n"
+        "                  Arguments following the source file are passed to the program.\n"
         ,
         "Rarely needed options:\n"
         "  --safe          Allow only the listed packages to use C FFI.\n"
@@ -136,7 +186,17 @@ static void usage()
         "                  Defaults to detecting all CPU features from the host.\n"
         "  --triple        Set the target triple.\n"
         "    =name         Defaults to the host triple.\n"
-        "  --stats         Print some compiler stats.\n"
+        "  --stats         Print time, memory and counts for each compiler phase.\n"
+        "                  All work is then done in one process, ignoring --jobs.\n"
+        "  --stats-json    Also write the --stats report as JSON to this file.\n"
+        "    =path         Use - for stdout.\n"
+        "  --time-trace    Write a timeline of compilation to this file, for\n"
+        "    =path         chrome://tracing or Perfetto. As with --stats, all\n"
+        "                  work is then done in one process, ignoring --jobs.\n"
+        "  --arena-size    Grow the IR's memory arena by this much at a time.\n"
+        "    =kilobytes    Defaults to 1024.\n"
+        "  --str-arena-size  Grow the string memory arena by this much at a time.\n"
+        "    =kilobytes    Defaults to 512.\n"
         "  --link-arch     Set the linking architecture.\n"
         "    =name         Default is the host architecture.\n"
         "  --linker        Set the linker command to use.\n"
@@ -151,6 +211,9 @@ static void usage()
         "    =4            Very low-level detail.\n"
         "  --ir            Output an IR tree for the whole program.\n"
         "  --asm           Output an assembly file.\n"
+        "                  Costs a second codegen run, as LLVM makes the object file\n"
+        "                  and the assembly separately. The two run in parallel, where\n"
+        "                  jobs can be forked.\n"
         "  --llvmir        Output an LLVM IR file.\n"
         "  --trace, -t     Enable parse trace.\n"
         "  --width, -w     Width to target when printing the IR.\n"
@@ -184,6 +247,10 @@ int coneOptSet(ConeOptions *opt, int *argc, char **argv) {
     opt.pic = 1;
 #endif
     opt->release = 1;
+    opt->optlevel = 2;
+    opt->jobs = 1;
+    opt->units = 1;
+    opt->cache_size = (size_t)512 << 20;
 
     while ((id = optNext(&s)) != -1) {
         switch (id) {
@@ -195,13 +262,33 @@ int coneOptSet(ConeOptions *opt, int *argc, char **argv) {
             usage();
             return 0;
 
-        case OPT_DEBUG: opt->release = 0; break;
+        case OPT_DEBUG: opt->release = 0; opt->optlevel = 0; opt->sizelevel = 0; break;
+        case OPT_OPTLEVEL:
+            opt->sizelevel = 0;
+            if (s.arg_val[0] == 's' || s.arg_val[0] == 'z') {
+                opt->optlevel = 2;
+                opt->sizelevel = s.arg_val[0] == 's' ? 1 : 2;
+            }
+            else if (s.arg_val[0] >= '0' && s.arg_val[0] <= '3' && s.arg_val[1] == '\0')
+                opt->optlevel = s.arg_val[0] - '0';
+            else {
+                printf("Unrecognised optimization level: -O%s\n", s.arg_val);
+                ok = 0;
+            }
+            break;
         case OPT_STRIP: opt->strip_debug = 1; break;
-        case OPT_OUTPUT: opt->output = s.arg_val; break;
+        case OPT_OUTPUT:
+            // Other requested files go to the current directory when the object goes to stdout
+            if (strcmp(s.arg_val, "-") == 0)
+                opt->obj_stdout = 1;
+            else
+                opt->output = s.arg_val;
+            break;
         case OPT_LIBRARY: opt->library = 1; break;
         case OPT_RUNTIMEBC: opt->runtimebc = 1; break;
         case OPT_PIC: opt->pic = 1; break;
         case OPT_NOPIC: opt->pic = 0; break;
+        case OPT_RUN: opt->run = 1; break;
         case OPT_DOCS:
         {
             opt->docs = 1;
@@ -230,8 +317,36 @@ int coneOptSet(ConeOptions *opt, int *argc, char **argv) {
         case OPT_FEATURES: opt->features = s.arg_val; break;
         case OPT_TRIPLE: opt->triple = s.arg_val; break;
         case OPT_STATS: opt->print_stats = 1; break;
+        case OPT_STATS_JSON: opt->print_stats = 1; opt->stats_json = s.arg_val; break;
+        case OPT_TIME_TRACE: opt->time_trace = s.arg_val; break;
+        case OPT_ARENA_SIZE:
+        case OPT_STR_ARENA_SIZE: {
+            // Round up to a whole number of 4096 byte pages
+            int kb = atoi(s.arg_val);
+            size_t size = (size_t)(kb < 4 ? 4 : kb + 3) / 4 * 4096;
+            if (id == OPT_ARENA_SIZE)
+                gMemBlkArenaSize = size;
+            else
+                gMemStrArenaSize = size;
+            break;
+        }
         case OPT_LINK_ARCH: opt->link_arch = s.arg_val; break;
         case OPT_LINKER: opt->linker = s.arg_val; break;
+        case OPT_JOBS:
+            opt->jobs = atoi(s.arg_val);
+            if (opt->jobs < 1)
+                opt->jobs = 1;
+            break;
+        case OPT_CACHE: opt->cache = 1; break;
+        case OPT_INCREMENTAL: opt->incremental = 1; break;
+        case OPT_CACHE_DIR: opt->cache = 1; opt->cache_dir = s.arg_val; break;
+        case OPT_CACHE_SIZE: opt->cache_size = (size_t)atoi(s.arg_val) << 20; break;
+        case OPT_SERVER: opt->server = s.arg_val; break;
+        case OPT_UNITS:
+            opt->units = atoi(s.arg_val);
+            if (opt->units < 1)
+                opt->units = 1;
+            break;
 
         case OPT_IR: opt->print_ir = 1; break;
         case OPT_ASM: opt->print_asm = 1; break;
@@ -34,6 +34,15 @@ typedef struct ConeOptions {
     void* data; // User-defined data for unit test callbacks
 
     int ptrsize;    // Size of a pointer (in bits)
+    int jobs;        // Number of parallel jobs used to parse files and generate function bodies
+    int units;        // Number of codegen units optimized and emitted in parallel
+    char *cache_dir;    // Folder for cached outputs (NULL=default)
+    char *stats_json;    // File to write --stats report to as JSON (NULL=none, "-"=stdout)
+    char *time_trace;    // File to write a Chrome trace-event timeline of compilation to (NULL=none)
+    char *server;    // Local socket path to serve compile requests on (NULL=not a server)
+    size_t cache_size;    // Maximum size of the output cache, in bytes
+    int optlevel;    // Optimization level: 0-3 (-O0 to -O3). Default is 2
+    int sizelevel;    // Optimize for size: 0=speed, 1=-Os, 2=-Oz
 
     // Boolean flags
     int wasm;        // 1=WebAssembly
@@ -43,6 +52,10 @@ typedef struct ConeOptions {
     int pic;        // Compile using position independent code
     int print_stats;    // Print some compiler statistics
     int verify;        // Verify LLVM IR
+    int run;        // Run the compiled program in-process, rather than emit object files
+    int obj_stdout;    // Write the object file to stdout (--output=-)
+    int cache;        // Reuse cached object files for identical inputs
+    int incremental;    // Regenerate only functions changed since the last build
     int extfun;        // Set function default linkage to external
     int simple_builtin;    // Use a minimal builtin package
     int strip_debug;    // Strip debug info
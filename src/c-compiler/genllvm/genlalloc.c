@@ -46,10 +46,10 @@ void genlDealiasFlds(GenState *gen, LLVMValueRef ref, RefNode *refnode) {
     StructNode *strnode = (StructNode*)itypeGetTypeDcl(refnode->pvtype);
     if (strnode->tag != StructTag)
         return;
-    INode **nodesp;
+    MemRef *nodesp;
     uint32_t cnt;
     for (imethnodesFor(&strnode->methprops, cnt, nodesp)) {
-        VarDclNode *field = (VarDclNode *)*nodesp;
+        VarDclNode *field = (VarDclNode *)imethRefNode(*nodesp);
         if (field->tag != VarDclTag)
             continue;
         RefNode *vartype = (RefNode *)field->vtype;
@@ -35,14 +35,16 @@ LLVMValueRef genlIf(GenState *gen, IfNode *ifnode) {
     LLVMBasicBlockRef *blks;
     INode **nodesp;
     uint32_t cnt;
+    MemMark mark = memScratchMark();
 
     // If we are returning a value in each block, set up space for phi info
+    // (only needed until the phi is built, so it is scratch)
     vtype = iexpGetTypeDcl(ifnode->vtype);
     count = ifnode->condblk->used / 2;
     i = phicnt = 0;
     if (vtype != voidType) {
-        blkvals = memAllocBlk(count * sizeof(LLVMValueRef));
-        blks = memAllocBlk(count * sizeof(LLVMBasicBlockRef));
+        blkvals = memScratchAlloc(count * sizeof(LLVMValueRef));
+        blks = memScratchAlloc(count * sizeof(LLVMBasicBlockRef));
     }
 
     endif = genlInsertBlock(gen, "endif");
@@ -82,13 +84,13 @@ LLVMValueRef genlIf(GenState *gen, IfNode *ifnode) {
     }
 
     // Merge point at end of if. Create merged phi value if needed.
+    LLVMValueRef phi = NULL;
     if (phicnt) {
-        LLVMValueRef phi = LLVMBuildPhi(gen->builder, genlType(gen, vtype), "ifval");
+        phi = LLVMBuildPhi(gen->builder, genlType(gen, vtype), "ifval");
         LLVMAddIncoming(phi, blkvals, blks, phicnt);
-        return phi;
     }
-
-    return NULL;
+    memScratchRelease(mark);
+    return phi;
 }
 
 // Obtain value ref for a specific named intrinsic function
@@ -103,8 +105,10 @@ LLVMValueRef genlGetIntrinsicFn(GenState *gen, char *fnname, NameUseNode *fnuse)
 LLVMValueRef genlFnCall(GenState *gen, FnCallNode *fncall) {
 
     // Get Valuerefs for all the parameters to pass to the function
+    // (LLVM copies what it needs, so the argument array is scratch)
     LLVMValueRef fncallret = NULL;
-    LLVMValueRef *fnargs = (LLVMValueRef*)memAllocBlk(fncall->args->used * sizeof(LLVMValueRef*));
+    MemMark mark = memScratchMark();
+    LLVMValueRef *fnargs = (LLVMValueRef*)memScratchAlloc(fncall->args->used * sizeof(LLVMValueRef*));
     LLVMValueRef *fnarg = fnargs;
     INode **nodesp;
     uint32_t cnt;
@@ -123,7 +127,9 @@ LLVMValueRef genlFnCall(GenState *gen, FnCallNode *fncall) {
 
     // Handle call when we have a pointer to a function
     if (fncall->objfn->tag == DerefTag) {
-        return LLVMBuildCall(gen->builder, genlExpr(gen, ((DerefNode*)fncall->objfn)->exp), fnargs, fncall->args->used, "");
+        fncallret = LLVMBuildCall(gen->builder, genlExpr(gen, ((DerefNode*)fncall->objfn)->exp), fnargs, fncall->args->used, "");
+        memScratchRelease(mark);
+        return fncallret;
     }
 
     // A function call may be to an intrinsic, or to program-defined code
@@ -375,6 +381,7 @@ LLVMValueRef genlFnCall(GenState *gen, FnCallNode *fncall) {
     // For += operators, store value in lval
     if (fncall->flags & FlagLvalOp)
         LLVMBuildStore(gen->builder, fncallret, selfaddr);
+    memScratchRelease(mark);
     return fncallret;
 }
 
@@ -595,8 +602,10 @@ void genlStore(GenState *gen, INode *lval, LLVMValueRef rval) {
 // Generate a term
 LLVMValueRef genlExpr(GenState *gen, INode *termnode) {
     if (!gen->opt->release && gen->fn) {
+        char *linep;
+        uint32_t linenbr = inodeLine(termnode, &linep);
         LLVMMetadataRef loc = LLVMDIBuilderCreateDebugLocation(gen->context, 
-            termnode->linenbr, termnode->srcp-termnode->linep, LLVMGetSubprogram(gen->fn), NULL);
+            linenbr, inodeSrcPtr(termnode) - linep, LLVMGetSubprogram(gen->fn), NULL);
         LLVMValueRef val = LLVMMetadataAsValue(gen->context, loc);
         LLVMSetCurrentDebugLocation(gen->builder, val);
     }
@@ -618,11 +627,15 @@ LLVMValueRef genlExpr(GenState *gen, INode *termnode) {
         INode **nodesp;
         uint32_t cnt;
         if (littype->tag == ArrayTag) {
-            LLVMValueRef *values = (LLVMValueRef *)memAllocBlk(size * sizeof(LLVMValueRef *));
+            MemMark mark = memScratchMark();
+            LLVMValueRef *values = (LLVMValueRef *)memScratchAlloc(size * sizeof(LLVMValueRef *));
             LLVMValueRef *valuep = values;
+            LLVMValueRef array;
             for (nodesFor(lit->args, cnt, nodesp))
                 *valuep++ = genlExpr(gen, *nodesp);
-            return LLVMConstArray(genlType(gen, ((ArrayNode *)lit->vtype)->elemtype), values, size);
+            array = LLVMConstArray(genlType(gen, ((ArrayNode *)lit->vtype)->elemtype), values, size);
+            memScratchRelease(mark);
+            return array;
         }
         else if (littype->tag == StructTag) {
             LLVMValueRef strval = LLVMGetUndef(genlType(gen, littype));
@@ -0,0 +1,270 @@
+/** Incremental generation: reuse unchanged functions from an earlier build
+ * @file
+ *
+ * After generating a package, its module (with function passes already run on
+ * every body) is saved as bitcode next to the object file, along with a
+ * fingerprint of every named function. A function's fingerprint digests:
+ * - its name and the source text of its body
+ * - the package's interface: the compiler's build and code-shaping options,
+ *   plus all source text outside function bodies (types, signatures, globals...)
+ *
+ * On the next build, any function whose fingerprint is unchanged is not
+ * generated again (genlFn skips it). Instead, its optimized body is spliced
+ * in from the saved module by linking the saved module into the new one.
+ * Any change to the interface changes every fingerprint, conservatively
+ * regenerating everything.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "../ir/ir.h"
+#include "../parser/lexer.h"
+#include "../shared/error.h"
+#include "../shared/fileio.h"
+#include "../shared/digest.h"
+#include "../coneopts.h"
+#include "../conec.h"
+#include "genllvm.h"
+
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Linker.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A function's fingerprint
+typedef struct GenIncFn {
+    char *name;            // Function's global (mangled) name
+    FnDclNode *fn;        // Function declaration (NULL for fingerprints from the earlier build)
+    char fp[33];        // Fingerprint, as hex digits
+} GenIncFn;
+
+// A function body's span of source locations
+typedef struct GenIncSpan {
+    uint32_t start;
+    uint32_t end;
+} GenIncSpan;
+
+static LLVMModuleRef genlIncPrev;    // Module saved by the earlier build (or NULL)
+static GenIncFn *genlIncFns;        // This build's fingerprints, sorted by name
+static size_t genlIncCnt;
+
+// Collect every function with a parsed body, including methods
+static void genlIncCollect(ModuleNode *mod, Nodes **fns) {
+    uint32_t cnt;
+    INode **nodesp;
+    for (nodesFor(mod->nodes, cnt, nodesp)) {
+        INode *nodep = *nodesp;
+        if (nodep->tag == FnDclTag && ((FnDclNode*)nodep)->srcend)
+            nodesAdd(fns, nodep);
+        else if (nodep->tag == ModuleTag)
+            genlIncCollect((ModuleNode*)nodep, fns);
+        else if (isMethodType(nodep)) {
+            uint32_t mcnt;
+            MemRef *methp;
+            for (imethnodesFor(&((IMethodNode*)nodep)->methprops, mcnt, methp)) {
+                INode *meth = imethRefNode(*methp);
+                if (meth->tag == FnDclTag && ((FnDclNode*)meth)->srcend)
+                    nodesAdd(fns, meth);
+            }
+        }
+    }
+}
+
+// Order spans by their source location (so by source file, then by position)
+static int genlIncSpanCmp(const void *a, const void *b) {
+    uint32_t pa = ((GenIncSpan *)a)->start;
+    uint32_t pb = ((GenIncSpan *)b)->start;
+    return pa < pb ? -1 : pa > pb;
+}
+
+// Order fingerprints by name
+static int genlIncFnCmp(const void *a, const void *b) {
+    return strcmp(((GenIncFn *)a)->name, ((GenIncFn *)b)->name);
+}
+
+// Digest the package's interface: options plus all source text outside function bodies
+static void genlIncInterface(GenState *gen, Nodes *fns, Digest *digest) {
+    ConeOptions *opt = gen->opt;
+    GenIncSpan *spans = (GenIncSpan *)memAllocBlk((fns->used + 1) * sizeof(GenIncSpan));
+    SrcFile **files = (SrcFile **)memAllocBlk((fns->used + 1) * sizeof(SrcFile *));
+    uint32_t nfiles = 0;
+    uint32_t i, j;
+
+    digestInit(digest);
+    digestStr(digest, conecBuildId());
+    digestStr(digest, opt->triple);
+    digestStr(digest, opt->cpu);
+    digestStr(digest, opt->features);
+    digestBytes(digest, &opt->optlevel, sizeof(opt->optlevel));
+    digestBytes(digest, &opt->sizelevel, sizeof(opt->sizelevel));
+    digestBytes(digest, &opt->pic, sizeof(opt->pic));
+    digestBytes(digest, &opt->library, sizeof(opt->library));
+    digestBytes(digest, &opt->extfun, sizeof(opt->extfun));
+
+    // Sort body spans by source location. Every source file has its own range
+    // of source locations, so spans from the same file end up together and in order.
+    for (i = 0; i < fns->used; ++i) {
+        FnDclNode *fn = (FnDclNode *)nodesGet(fns, i);
+        SrcFile *file = inodeSrcFile(fn->value);
+        spans[i].start = fn->value->srcloc;
+        spans[i].end = fn->srcend;
+        for (j = 0; j < nfiles && files[j] != file; ++j);
+        if (j == nfiles)
+            files[nfiles++] = file;
+    }
+    qsort(spans, fns->used, sizeof(GenIncSpan), genlIncSpanCmp);
+
+    // Digest each source file, skipping over the function bodies within it
+    for (j = 0; j < nfiles; ++j) {
+        uint32_t srcloc = files[j]->base;
+        uint32_t srcend = srcloc + files[j]->size;
+        digestStr(digest, files[j]->url);
+        for (i = 0; i < fns->used; ++i) {
+            if (spans[i].start < srcloc || spans[i].start >= srcend)
+                continue;    // From another source file, or nested in a span already skipped
+            digestBytes(digest, srclocPtr(srcloc), spans[i].start - srcloc);
+            srcloc = spans[i].end;
+        }
+        digestBytes(digest, srclocPtr(srcloc), srcend - srcloc);
+    }
+}
+
+// Load the fingerprints saved by the earlier build, sorted by name
+static GenIncFn *genlIncLoadFps(char *path, size_t *cnt) {
+    GenIncFn *fps;
+    char *src, *srcp, *eol;
+    size_t avail = 256;
+
+    *cnt = 0;
+    if (!(src = fileLoad(path)))
+        return NULL;
+    fps = (GenIncFn *)malloc(avail * sizeof(GenIncFn));
+
+    // Each line is a fingerprint (32 hex digits), a space, and the function's name
+    for (srcp = src; (eol = strchr(srcp, '\n')) && eol - srcp > 33 && srcp[32] == ' '; srcp = eol + 1) {
+        if (*cnt == avail) {
+            avail <<= 1;
+            fps = (GenIncFn *)realloc(fps, avail * sizeof(GenIncFn));
+        }
+        memcpy(fps[*cnt].fp, srcp, 32);
+        fps[*cnt].fp[32] = '\0';
+        fps[*cnt].name = memAllocStr(srcp + 33, eol - srcp - 33);
+        fps[*cnt].fn = NULL;
+        ++*cnt;
+    }
+    qsort(fps, *cnt, sizeof(GenIncFn), genlIncFnCmp);
+    return fps;
+}
+
+// Find a function's fingerprint by name
+static GenIncFn *genlIncFind(GenIncFn *fps, size_t cnt, char *name) {
+    GenIncFn key;
+    key.name = name;
+    return fps ? (GenIncFn *)bsearch(&key, fps, cnt, sizeof(GenIncFn), genlIncFnCmp) : NULL;
+}
+
+// Fingerprint every function and load the earlier build's module.
+// Functions whose fingerprint has not changed are flagged to be reused.
+void genlIncPrepare(GenState *gen, ModuleNode *mod) {
+    Nodes *fns = newNodes(64);
+    Digest interface;
+    GenIncFn *oldfps;
+    size_t oldcnt, i;
+    LLVMMemoryBufferRef bitcode;
+    char *err;
+
+    genlIncPrev = NULL;
+    genlIncCollect(mod, &fns);
+    genlIncInterface(gen, fns, &interface);
+
+    // Fingerprint every function that has a name
+    genlIncFns = (GenIncFn *)memAllocBlk((fns->used + 1) * sizeof(GenIncFn));
+    genlIncCnt = 0;
+    for (i = 0; i < fns->used; ++i) {
+        FnDclNode *fn = (FnDclNode *)nodesGet(fns, i);
+        GenIncFn *incfn = &genlIncFns[genlIncCnt];
+        Digest digest = interface;
+        incfn->name = genlGlobalName((INamedNode *)fn);
+        if (*incfn->name == '\0')
+            continue;
+        incfn->fn = fn;
+        digestStr(&digest, incfn->name);
+        digestBytes(&digest, inodeSrcPtr(fn->value), fn->srcend - fn->value->srcloc);
+        digestHex(&digest, incfn->fp);
+        ++genlIncCnt;
+    }
+    qsort(genlIncFns, genlIncCnt, sizeof(GenIncFn), genlIncFnCmp);
+
+    // Load what the earlier build saved. If anything is missing, everything is generated.
+    oldfps = genlIncLoadFps(fileMakePath(gen->opt->output, inodeSrcFile(mod)->fname, "incfp"), &oldcnt);
+    if (oldfps == NULL)
+        return;
+    if (LLVMCreateMemoryBufferWithContentsOfFile(fileMakePath(gen->opt->output, inodeSrcFile(mod)->fname, "incbc"), &bitcode, &err) != 0) {
+        LLVMDisposeMessage(err);
+        free(oldfps);
+        return;
+    }
+    if (LLVMParseBitcodeInContext2(gen->context, bitcode, &genlIncPrev) != 0)
+        genlIncPrev = NULL;
+    LLVMDisposeMemoryBuffer(bitcode);
+
+    // Reuse every uniquely named function whose fingerprint and saved body are intact
+    for (i = 0; genlIncPrev && i < genlIncCnt; ++i) {
+        GenIncFn *incfn = &genlIncFns[i];
+        GenIncFn *oldfn = genlIncFind(oldfps, oldcnt, incfn->name);
+        LLVMValueRef prevfn;
+        if ((i > 0 && strcmp(incfn->name, genlIncFns[i - 1].name) == 0)
+            || (i + 1 < genlIncCnt && strcmp(incfn->name, genlIncFns[i + 1].name) == 0))
+            continue;
+        if (oldfn && strcmp(oldfn->fp, incfn->fp) == 0
+            && (prevfn = LLVMGetNamedFunction(genlIncPrev, incfn->name)) && !LLVMIsDeclaration(prevfn))
+            incfn->fn->flags |= FlagReuse;
+    }
+    free(oldfps);
+}
+
+// Splice reused function bodies into the newly generated module,
+// then save the module and fingerprints for the next build
+void genlIncFinish(GenState *gen, ModuleNode *mod) {
+    LLVMValueRef glo, next;
+    FILE *fpfile;
+    size_t i;
+
+    if (genlIncPrev) {
+        // Keep only the earlier module's reused bodies, plus anything they privately depend on
+        for (glo = LLVMGetFirstFunction(genlIncPrev); glo; glo = next) {
+            GenIncFn *incfn;
+            next = LLVMGetNextFunction(glo);
+            if (LLVMIsDeclaration(glo) || LLVMGetLinkage(glo) != LLVMExternalLinkage)
+                continue;
+            if (*LLVMGetValueName(glo) == '\0')
+                LLVMSetLinkage(glo, LLVMInternalLinkage);
+            else if (!(incfn = genlIncFind(genlIncFns, genlIncCnt, (char*)LLVMGetValueName(glo)))
+                || !(incfn->fn->flags & FlagReuse))
+                genlUnitDropFn(glo);
+        }
+        for (glo = LLVMGetFirstGlobal(genlIncPrev); glo; glo = LLVMGetNextGlobal(glo)) {
+            if (!LLVMIsDeclaration(glo) && LLVMGetLinkage(glo) == LLVMExternalLinkage)
+                LLVMSetInitializer(glo, NULL);
+        }
+        if (LLVMLinkModules2(gen->module, genlIncPrev) != 0)
+            errorMsg(ErrorGenErr, "Could not splice in functions from the earlier incremental build");
+        genlIncPrev = NULL;
+    }
+    if (errors)
+        return;
+
+    // Save the module (before module-level optimization) and its fingerprints
+    if (LLVMWriteBitcodeToFile(gen->module, fileMakePath(gen->opt->output, inodeSrcFile(mod)->fname, "incbc")) != 0
+        || !(fpfile = fopen(fileMakePath(gen->opt->output, inodeSrcFile(mod)->fname, "incfp"), "wb"))) {
+        errorMsg(ErrorGenErr, "Could not save incremental build state");
+        return;
+    }
+    for (i = 0; i < genlIncCnt; ++i)
+        fprintf(fpfile, "%s %s\n", genlIncFns[i].fp, genlIncFns[i].name);
+    fclose(fpfile);
+}
@@ -0,0 +1,66 @@
+/** In-process execution of generated code via LLVM's MCJIT
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "../shared/error.h"
+#include "../coneopts.h"
+#include "genllvm.h"
+
+#include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/Support.h>
+
+#include <stdio.h>
+#include <stdint.h>
+
+// The standard library (src/conestd) is linked into the compiler,
+// so that jitted programs can call it directly.
+void print(char *p);
+void printInt(int64_t nbr);
+void printFloat(double nbr);
+void printChar(uint64_t code);
+
+// Make the standard library's functions resolvable by jitted code
+void genlJitSymbols() {
+    LLVMAddSymbol("print", (void*)print);
+    LLVMAddSymbol("printInt", (void*)printInt);
+    LLVMAddSymbol("printFloat", (void*)printFloat);
+    LLVMAddSymbol("printChar", (void*)printChar);
+}
+
+// Compile the generated module to native code in memory, then run its main function.
+// argv[0] is the program's name. Returns main's return value, or ExitError if it cannot be run.
+int genlJitRun(GenState *gen, int argc, char **argv) {
+    static const char *envp[] = { NULL };
+    struct LLVMMCJITCompilerOptions options;
+    LLVMExecutionEngineRef engine;
+    LLVMValueRef mainfn;
+    char *err;
+    int result;
+
+    if (!(mainfn = LLVMGetNamedFunction(gen->module, "main")) || LLVMIsDeclaration(mainfn)) {
+        errorMsg(ErrorGenErr, "Cannot run a program that has no main function");
+        return ExitError;
+    }
+
+    LLVMLinkInMCJIT();
+    genlJitSymbols();
+    LLVMInitializeMCJITCompilerOptions(&options, sizeof(options));
+    options.OptLevel = gen->opt->optlevel;
+    if (LLVMCreateMCJITCompilerForModule(&engine, gen->module, &options, sizeof(options), &err) != 0) {
+        errorMsg(ErrorGenErr, "Could not create JIT: %s", err);
+        LLVMDisposeMessage(err);
+        return ExitError;
+    }
+
+    // The engine now owns the module, and disposes of it along with itself
+    LLVMRunStaticConstructors(engine);
+    result = LLVMRunFunctionAsMain(engine, mainfn, argc, (const char * const *)argv, envp);
+    LLVMRunStaticDestructors(engine);
+    fflush(stdout);
+    LLVMDisposeExecutionEngine(engine);
+    gen->module = NULL;
+    return result;
+}
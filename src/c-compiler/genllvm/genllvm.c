@@ -11,19 +11,26 @@
 #include "../coneopts.h"
 #include "../ir/nametbl.h"
 #include "../shared/fileio.h"
+#include "../shared/jobs.h"
+#include "../shared/trace.h"
 #include "genllvm.h"
 
 #include <llvm-c/ExecutionEngine.h>
 #include <llvm-c/Target.h>
 #include <llvm-c/Analysis.h>
+#include <llvm-c/BitReader.h>
 #include <llvm-c/BitWriter.h>
+#include <llvm-c/Linker.h>
 #include <llvm-c/Transforms/Scalar.h>
 #include <llvm-c/Transforms/IPO.h>
+#include <llvm-c/Transforms/Vectorize.h>
+#include <llvm-c/Transforms/PassManagerBuilder.h>
 #if LLVM_VERSION_MAJOR >= 7
 #include "llvm-c/Transforms/Utils.h"
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 
@@ -45,7 +52,8 @@ void genlParmVar(GenState *gen, VarDclNode *var) {
 
 // Generate a function
 void genlFn(GenState *gen, FnDclNode *fnnode) {
-    if (fnnode->value->tag == IntrinsicTag)
+    // Intrinsics have no body, and reused bodies are spliced in from an earlier build
+    if (fnnode->value->tag == IntrinsicTag || (fnnode->flags & FlagReuse))
         return;
 
     LLVMValueRef svfn = gen->fn;
@@ -54,6 +62,7 @@ void genlFn(GenState *gen, FnDclNode *fnnode) {
 
     assert(fnnode->value->tag == BlockTag);
     gen->fn = fnnode->llvmvar;
+    traceBegin("gen", (char*)LLVMGetValueName(gen->fn));
 
     // Attach block and builder to function
     LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(gen->context, gen->fn, "entry");
@@ -71,6 +80,14 @@ void genlFn(GenState *gen, FnDclNode *fnnode) {
 
     LLVMDisposeBuilder(gen->builder);
 
+    // Optimize the function while its IR is still hot in the cache
+    if (gen->fnpassmgr && errors == 0) {
+        traceBegin("llvm", "function passes");
+        LLVMRunFunctionPassManager(gen->fnpassmgr, gen->fn);
+        traceEnd();
+    }
+
+    traceEnd();
     gen->builder = svbuilder;
     gen->fn = svfn;
 }
@@ -144,11 +161,12 @@ void genlGloFnName(GenState *gen, FnDclNode *glofn) {
             LLVMSetVisibility(glofn->llvmvar, LLVMDefaultVisibility);
         }
         if (!gen->opt->release && glofn->value) {
+            uint32_t linenbr = inodeLine(glofn, NULL);
             LLVMMetadataRef fntype = LLVMDIBuilderCreateSubroutineType(gen->dibuilder,
                 gen->difile, NULL, 0, 0);
             LLVMMetadataRef sp = LLVMDIBuilderCreateFunction(gen->dibuilder, gen->difile,
                 fnname, strlen(fnname), manglednm, strlen(manglednm),
-                gen->difile, glofn->linenbr, fntype, 0, 1, glofn->linenbr, LLVMDIFlagPublic, 0);
+                gen->difile, linenbr, fntype, 0, 1, linenbr, LLVMDIFlagPublic, 0);
             LLVMSetSubprogram(glofn->llvmvar, sp);
         }
     }
@@ -203,7 +221,143 @@ void genlModule(GenState *gen, ModuleNode *mod) {
     }
 }
 
+// Declare all global names and generate all named types (and their methods),
+// so that function bodies can then be generated in any order
+void genlModuleNames(GenState *gen, ModuleNode *mod) {
+    uint32_t cnt;
+    INode **nodesp;
+    for (nodesFor(mod->nodes, cnt, nodesp)) {
+        INode *nodep = *nodesp;
+        if (nodep->tag == VarDclTag)
+            genlGloVarName(gen, (VarDclNode *)nodep);
+        else if (nodep->tag == FnDclTag)
+            genlGloFnName(gen, (FnDclNode *)nodep);
+        else if (nodep->tag == ModuleTag)
+            genlModuleNames(gen, (ModuleNode*)nodep);
+        else if (isTypeNode(nodep) || nodep->tag == AllocTag)
+            genlType(gen, nodep);
+    }
+}
+
+// Collect (in order) every global function that has a body to generate
+void genlModuleFns(ModuleNode *mod, Nodes **fns) {
+    uint32_t cnt;
+    INode **nodesp;
+    for (nodesFor(mod->nodes, cnt, nodesp)) {
+        INode *nodep = *nodesp;
+        if (nodep->tag == FnDclTag && ((FnDclNode*)nodep)->value)
+            nodesAdd(fns, nodep);
+        else if (nodep->tag == ModuleTag)
+            genlModuleFns((ModuleNode*)nodep, fns);
+    }
+}
+
+// Generate initial values for every global variable
+void genlModuleVars(GenState *gen, ModuleNode *mod) {
+    uint32_t cnt;
+    INode **nodesp;
+    for (nodesFor(mod->nodes, cnt, nodesp)) {
+        INode *nodep = *nodesp;
+        if (nodep->tag == VarDclTag && ((VarDclNode*)nodep)->value)
+            genlGloVar(gen, (VarDclNode*)nodep);
+        else if (nodep->tag == ModuleTag)
+            genlModuleVars(gen, (ModuleNode*)nodep);
+    }
+}
+
+// Context shared with forked function generation jobs
+typedef struct GenJobs {
+    GenState *gen;
+    Nodes *fns;
+    int nbr;
+} GenJobs;
+
+// A forked job's work: generate every nbr'th function body, then return
+// its partial module as bitcode. Bodies that were already generated before
+// the fork (e.g., methods) are marked available_externally,
+// so that linking keeps the parent's definition.
+char *genlFnsJob(int index, void *context, size_t *size) {
+    GenJobs *jobs = (GenJobs*)context;
+    GenState *gen = jobs->gen;
+    LLVMValueRef fn;
+    LLVMMemoryBufferRef bitcode;
+    uint32_t i;
+
+    for (fn = LLVMGetFirstFunction(gen->module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (!LLVMIsDeclaration(fn))
+            LLVMSetLinkage(fn, LLVMAvailableExternallyLinkage);
+    }
+
+    for (i = index; i < jobs->fns->used; i += jobs->nbr)
+        genlFn(gen, (FnDclNode*)nodesGet(jobs->fns, i));
+    if (errors)
+        return NULL;
+
+    bitcode = LLVMWriteBitcodeToMemoryBuffer(gen->module);
+    *size = LLVMGetBufferSize(bitcode);
+    return (char *)LLVMGetBufferStart(bitcode);
+}
+
+// Generate module's nodes, using forked jobs to generate function bodies in parallel.
+// Each job's partial module is then linked back into the package's module.
+void genlModuleJobs(GenState *gen, ModuleNode *mod) {
+    GenJobs jobs;
+    char **results;
+    size_t *sizes;
+    int i, ok;
+
+    genlModuleNames(gen, mod);
+    jobs.gen = gen;
+    jobs.fns = newNodes(64);
+    genlModuleFns(mod, &jobs.fns);
+    jobs.nbr = gen->opt->jobs < (int)jobs.fns->used ? gen->opt->jobs : (int)jobs.fns->used;
+
+    results = (char **)memAllocBlk(jobs.nbr * sizeof(char *));
+    sizes = (size_t *)memAllocBlk(jobs.nbr * sizeof(size_t));
+    ok = jobs.nbr > 1 ? jobsFork(jobs.nbr, genlFnsJob, &jobs, results, sizes) : -1;
+
+    // Generate serially if jobs are not available
+    if (ok < 0) {
+        uint32_t cnt;
+        INode **nodesp;
+        for (nodesFor(jobs.fns, cnt, nodesp))
+            genlFn(gen, (FnDclNode*)*nodesp);
+    }
+    else if (ok == 0)
+        errorMsg(ErrorGenErr, "Parallel generation of function bodies failed");
+
+    // Link each job's functions into the package's module
+    for (i = 0; ok > 0 && i < jobs.nbr; ++i) {
+        LLVMMemoryBufferRef bitcode;
+        LLVMModuleRef jobmod;
+        bitcode = LLVMCreateMemoryBufferWithMemoryRangeCopy(results[i], sizes[i], "job");
+        if (LLVMParseBitcodeInContext2(gen->context, bitcode, &jobmod) != 0
+            || LLVMLinkModules2(gen->module, jobmod) != 0)
+            errorMsg(ErrorGenErr, "Could not link generated functions from job %d", i);
+        LLVMDisposeMemoryBuffer(bitcode);
+    }
+    for (i = 0; ok >= 0 && i < jobs.nbr; ++i)
+        free(results[i]);
+
+    genlModuleVars(gen, mod);
+}
+
+// Create a pass manager builder for the requested optimization level
+LLVMPassManagerBuilderRef genlPassBuilder(ConeOptions *opt) {
+    LLVMPassManagerBuilderRef builder = LLVMPassManagerBuilderCreate();
+    LLVMPassManagerBuilderSetOptLevel(builder, opt->optlevel);
+    LLVMPassManagerBuilderSetSizeLevel(builder, opt->sizelevel);
+    if (opt->sizelevel == 2)
+        LLVMPassManagerBuilderUseInlinerWithThreshold(builder, 25);
+    else if (opt->sizelevel == 1)
+        LLVMPassManagerBuilderUseInlinerWithThreshold(builder, 75);
+    else if (opt->optlevel >= 2)
+        LLVMPassManagerBuilderUseInlinerWithThreshold(builder, opt->optlevel == 3 ? 275 : 225);
+    return builder;
+}
+
 void genlPackage(GenState *gen, ModuleNode *mod) {
+    LLVMPassManagerBuilderRef builder = NULL;
     char *error = NULL;
 
     assert(mod->tag == ModuleTag);
@@ -214,32 +368,71 @@ void genlPackage(GenState *gen, ModuleNode *mod) {
         gen->compileUnit = LLVMDIBuilderCreateCompileUnit(gen->dibuilder, LLVMDWARFSourceLanguageC,
             gen->difile, "Cone compiler", 13, 0, "", 0, 0, "", 0, LLVMDWARFEmissionFull, 0, 0, 0);
     }
-    genlModule(gen, mod);
+
+    // Function-level simplification (mem2reg, SROA, early CSE, ...) runs in genlFn
+    gen->fnpassmgr = NULL;
+    if (gen->opt->optlevel > 0 || gen->opt->sizelevel > 0) {
+        builder = genlPassBuilder(gen->opt);
+        gen->fnpassmgr = LLVMCreateFunctionPassManagerForModule(gen->module);
+        LLVMPassManagerBuilderPopulateFunctionPassManager(builder, gen->fnpassmgr);
+        LLVMInitializeFunctionPassManager(gen->fnpassmgr);
+    }
+
+    // Incremental builds do not carry over debug info either
+    if (gen->opt->incremental && gen->opt->release)
+        genlIncPrepare(gen, mod);
+
+    // Parallel jobs do not yet carry debug info across to the linked module
+    if (gen->opt->jobs > 1 && gen->opt->release) {
+        traceBegin("gen", "parallel jobs");
+        genlModuleJobs(gen, mod);
+        traceEnd();
+    }
+    else
+        genlModule(gen, mod);
     if (!gen->opt->release)
         LLVMDIBuilderFinalize(gen->dibuilder);
+    if (gen->fnpassmgr) {
+        LLVMFinalizeFunctionPassManager(gen->fnpassmgr);
+        LLVMDisposePassManager(gen->fnpassmgr);
+        LLVMPassManagerBuilderDispose(builder);
+        gen->fnpassmgr = NULL;
+    }
+    if (gen->opt->incremental && gen->opt->release)
+        genlIncFinish(gen, mod);
 
     // Verify generated IR
+    traceBegin("llvm", "verify");
     LLVMVerifyModule(gen->module, LLVMReturnStatusAction, &error);
     if (error) {
         if (*error)
             errorMsg(ErrorGenErr, "Module verification failed:\n%s", error);
         LLVMDisposeMessage(error);
     }
+    traceEnd();
 }
 
+// A target machine kept warm (by the compile server), and the options it was created for
+static LLVMTargetMachineRef genlWarmMachine = NULL;
+static ConeOptions genlWarmOpt;
+
 // Use provided options (triple, etc.) to creation a machine
 LLVMTargetMachineRef genlCreateMachine(ConeOptions *opt) {
+    static int targetsReady = 0;
     char *err;
     LLVMTargetRef target;
     LLVMCodeGenOptLevel opt_level;
     LLVMRelocMode reloc;
     LLVMTargetMachineRef machine;
 
-    LLVMInitializeAllTargetInfos();
-    LLVMInitializeAllTargetMCs();
-    LLVMInitializeAllTargets();
-    LLVMInitializeAllAsmPrinters();
-    LLVMInitializeAllAsmParsers();
+    if (!targetsReady) {
+        LLVMInitializeAllTargetInfos();
+        LLVMInitializeAllTargetMCs();
+        LLVMInitializeAllTargets();
+        LLVMInitializeAllAsmPrinters();
+        LLVMInitializeAllAsmParsers();
+        targetsReady = 1;
+    }
 
     // Find target for the specified triple
     if (!opt->triple)
@@ -251,12 +444,26 @@ LLVMTargetMachineRef genlCreateMachine(ConeOptions *opt) {
     }
 
     // Create a specific target machine
-    opt_level = opt->release? LLVMCodeGenLevelAggressive : LLVMCodeGenLevelNone;
+    // -O0 uses the fast instruction selector and register allocator
+    switch (opt->optlevel) {
+    case 0: opt_level = LLVMCodeGenLevelNone; break;
+    case 1: opt_level = LLVMCodeGenLevelLess; break;
+    case 3: opt_level = LLVMCodeGenLevelAggressive; break;
+    default: opt_level = LLVMCodeGenLevelDefault; break;
+    }
     reloc = (opt->pic || opt->library)? LLVMRelocPIC : LLVMRelocDefault;
     if (!opt->cpu)
         opt->cpu = "generic";
     if (!opt->features)
         opt->features = "";
+
+    // Reuse the warm machine, if it was created for the same target and settings
+    if (genlWarmMachine && opt->optlevel == genlWarmOpt.optlevel
+        && reloc == ((genlWarmOpt.pic || genlWarmOpt.library)? LLVMRelocPIC : LLVMRelocDefault)
+        && strcmp(opt->triple, genlWarmOpt.triple) == 0 && strcmp(opt->cpu, genlWarmOpt.cpu) == 0
+        && strcmp(opt->features, genlWarmOpt.features) == 0)
+        return genlWarmMachine;
+
     if (!(machine = LLVMCreateTargetMachine(target, opt->triple, opt->cpu, opt->features, opt_level, reloc, LLVMCodeModelDefault))) {
         errorMsg(ErrorGenErr, "Could not create target machine");
         return NULL;
@@ -266,9 +473,50 @@ LLVMTargetMachineRef genlCreateMachine(ConeOptions *opt) {
 }
 
 // Generate requested object file
-void genlOut(char *objpath, char *asmpath, LLVMModuleRef mod, char *triple, LLVMTargetMachineRef machine) {
+// Context shared with forked output jobs
+typedef struct GenOut {
+    LLVMModuleRef mod;
+    LLVMTargetMachineRef machine;
+} GenOut;
+
+// Run the machine code pipeline once, into a memory buffer. Return NULL on failure.
+LLVMMemoryBufferRef genlOutBuffer(GenOut *out, LLVMCodeGenFileType filetype) {
+    LLVMMemoryBufferRef buf;
     char *err;
+    int ok;
+    traceBegin("emit", filetype == LLVMObjectFile ? "obj" : "asm");
+    ok = LLVMTargetMachineEmitToMemoryBuffer(out->machine, out->mod, filetype, &err, &buf) == 0;
+    traceEnd();
+    if (!ok) {
+        errorMsg(ErrorGenErr, "Could not emit %s file: %s", filetype == LLVMObjectFile ? "obj" : "asm", err);
+        LLVMDisposeMessage(err);
+        return NULL;
+    }
+    return buf;
+}
+
+// A forked output job's work: job 0 generates the object, job 1 the assembly
+char *genlOutJob(int index, void *context, size_t *size) {
+    LLVMMemoryBufferRef buf = genlOutBuffer((GenOut*)context, index == 0 ? LLVMObjectFile : LLVMAssemblyFile);
+    if (buf == NULL)
+        return NULL;
+    *size = LLVMGetBufferSize(buf);
+    return (char *)LLVMGetBufferStart(buf);
+}
+
+// Write out an artifact generated into a memory buffer, with one write
+void genlOutWrite(char *path, char *buf, size_t size, char *kind) {
+    if (!fileWrite(path, buf, size))
+        errorMsg(ErrorGenErr, "Could not write %s file: %s", kind, path);
+}
+
+// Generate requested object (and assembly) file.
+// LLVM can only produce one kind of file per codegen run, so when both
+// are requested, the assembly is generated in a forked job alongside the object.
+void genlOut(char *objpath, char *asmpath, LLVMModuleRef mod, char *triple, LLVMTargetMachineRef machine) {
     LLVMTargetDataRef dataref;
+    LLVMMemoryBufferRef buf;
+    GenOut out;
     char *layout;
 
     LLVMSetTarget(mod, triple);
@@ -277,56 +525,233 @@ void genlOut(char *objpath, char *asmpath, LLVMModuleRef mod, char *triple, LLVM
     LLVMSetDataLayout(mod, layout);
     LLVMDisposeMessage(layout);
 
-    // Generate assembly file if requested
-    if (asmpath && LLVMTargetMachineEmitToFile(machine, mod, asmpath, LLVMAssemblyFile, &err) != 0) {
-        errorMsg(ErrorGenErr, "Could not emit asm file: %s", err);
-        LLVMDisposeMessage(err);
+    out.mod = mod;
+    out.machine = machine;
+    if (asmpath) {
+        char *results[2];
+        size_t sizes[2];
+        int ok;
+        traceBegin("emit", "obj and asm jobs");
+        ok = jobsFork(2, genlOutJob, &out, results, sizes);
+        traceEnd();
+        if (ok >= 0) {
+            if (ok == 0)
+                errorMsg(ErrorGenErr, "Could not emit obj and asm files");
+            else {
+                genlOutWrite(objpath, results[0], sizes[0], "obj");
+                genlOutWrite(asmpath, results[1], sizes[1], "asm");
+            }
+            free(results[0]);
+            free(results[1]);
+            return;
+        }
+
+        // Forked jobs are unavailable: generate assembly first, then the object
+        if ((buf = genlOutBuffer(&out, LLVMAssemblyFile))) {
+            genlOutWrite(asmpath, (char *)LLVMGetBufferStart(buf), LLVMGetBufferSize(buf), "asm");
+            LLVMDisposeMemoryBuffer(buf);
+        }
     }
 
     // Generate .o or .obj file
-    if (LLVMTargetMachineEmitToFile(machine, mod, objpath, LLVMObjectFile, &err) != 0) {
-        errorMsg(ErrorGenErr, "Could not emit obj file: %s", err);
-        LLVMDisposeMessage(err);
+    if ((buf = genlOutBuffer(&out, LLVMObjectFile))) {
+        genlOutWrite(objpath, (char *)LLVMGetBufferStart(buf), LLVMGetBufferSize(buf), "obj");
+        LLVMDisposeMemoryBuffer(buf);
     }
 }
 
-// Generate IR nodes into LLVM IR using LLVM
-void genmod(GenState *gen, ModuleNode *mod) {
-    char *err;
+// Serialize the module's LLVM IR into a file, with one write
+void genlPrintIr(GenState *gen, char *fname, char *ext) {
+    char *ir;
+    traceBegin("emit", ext);
+    ir = LLVMPrintModuleToString(gen->module);
+    genlOutWrite(fileMakePath(gen->opt->output, fname, ext), ir, strlen(ir), ext);
+    LLVMDisposeMessage(ir);
+    traceEnd();
+}
 
-    // Generate IR to LLVM IR
-    genlPackage(gen, mod);
+// Optimize the generated LLVM IR according to the requested optimization level.
+// Function-level passes have already run on each function, as genlFn finished it.
+// -O0 skips IR optimization entirely, leaving the work to the fast instruction selector.
+void genlOptimize(GenState *gen) {
+    LLVMPassManagerBuilderRef builder;
+    LLVMPassManagerRef passmgr;
+    int optlevel = gen->opt->optlevel;
+    int sizelevel = gen->opt->sizelevel;
 
-    // Serialize the LLVM IR, if requested
-    if (gen->opt->print_llvmir && LLVMPrintModuleToFile(gen->module, fileMakePath(gen->opt->output, mod->lexer->fname, "preir"), &err) != 0) {
-        errorMsg(ErrorGenErr, "Could not emit pre-ir file: %s", err);
-        LLVMDisposeMessage(err);
-    }
+    if (optlevel == 0 && sizelevel == 0)
+        return;
 
-    // Optimize the generated LLVM IR
-    LLVMPassManagerRef passmgr = LLVMCreatePassManager();
-    LLVMAddDemoteMemoryToRegisterPass(passmgr);        // Demote allocas to registers.
-    LLVMAddInstructionCombiningPass(passmgr);        // Do simple "peephole" and bit-twiddling optimizations
-    LLVMAddReassociatePass(passmgr);                // Reassociate expressions.
-    LLVMAddGVNPass(passmgr);                        // Eliminate common subexpressions.
-    LLVMAddCFGSimplificationPass(passmgr);            // Simplify the control flow graph
-    if (gen->opt->release)
-        LLVMAddFunctionInliningPass(passmgr);        // Function inlining
+    // Module-level pipeline: inlining, GVN, loop passes (LICM, unrolling, ...)
+    traceBegin("llvm", "module passes");
+    builder = genlPassBuilder(gen->opt);
+    passmgr = LLVMCreatePassManager();
+    LLVMPassManagerBuilderPopulateModulePassManager(builder, passmgr);
     LLVMRunPassManager(passmgr, gen->module);
     LLVMDisposePassManager(passmgr);
+    LLVMPassManagerBuilderDispose(builder);
+    traceEnd();
+
+    // The C API builder leaves the vectorizers off, so run them (and their cleanup) after it
+    if (optlevel >= 2 && sizelevel == 0) {
+        traceBegin("llvm", "vectorize");
+        passmgr = LLVMCreatePassManager();
+        LLVMAddLoopVectorizePass(passmgr);
+        LLVMAddSLPVectorizePass(passmgr);
+        LLVMAddInstructionCombiningPass(passmgr);
+        LLVMAddCFGSimplificationPass(passmgr);
+        LLVMRunPassManager(passmgr, gen->module);
+        LLVMDisposePassManager(passmgr);
+        traceEnd();
+    }
+}
+
+// Return the path of the object file to generate for the named module
+char *genlObjPath(GenState *gen, char *fname) {
+    return gen->opt->obj_stdout? "-" : fileMakePath(gen->opt->output, fname, gen->opt->wasm? "wasm" : objext);
+}
 
+// Serialize optimized LLVM IR (if requested), then transform it to target's ASM and OBJ
+void genlEmit(GenState *gen, char *fname) {
     // Serialize the LLVM IR, if requested
-    if (gen->opt->print_llvmir && LLVMPrintModuleToFile(gen->module, fileMakePath(gen->opt->output, mod->lexer->fname, "ir"), &err) != 0) {
-        errorMsg(ErrorGenErr, "Could not emit ir file: %s", err);
-        LLVMDisposeMessage(err);
-    }
+    if (gen->opt->print_llvmir)
+        genlPrintIr(gen, fname, "ir");
 
-    // Transform IR to target's ASM and OBJ
-    if (gen->machine)
-        genlOut(fileMakePath(gen->opt->output, mod->lexer->fname, gen->opt->wasm? "wasm" : objext),
-            gen->opt->print_asm? fileMakePath(gen->opt->output, mod->lexer->fname, gen->opt->wasm? "wat" : asmext) : NULL,
+    // Transform IR to target's ASM and OBJ (unless it is to be run in-process)
+    if (gen->machine && !gen->opt->run)
+        genlOut(genlObjPath(gen, fname),
+            gen->opt->print_asm? fileMakePath(gen->opt->output, fname, gen->opt->wasm? "wat" : asmext) : NULL,
             gen->module, gen->opt->triple, gen->machine);
+}
+
+// Turn a function definition into a declaration, redirecting all its uses
+void genlUnitDropFn(LLVMValueRef fn) {
+    char *name = memAllocStr((char*)LLVMGetValueName(fn), strlen(LLVMGetValueName(fn)));
+    LLVMValueRef dcl = LLVMAddFunction(LLVMGetGlobalParent(fn), "", LLVMGetElementType(LLVMTypeOf(fn)));
+    LLVMSetFunctionCallConv(dcl, LLVMGetFunctionCallConv(fn));
+    LLVMSetDLLStorageClass(dcl, LLVMGetDLLStorageClass(fn));
+    LLVMReplaceAllUsesWith(fn, dcl);
+    LLVMDeleteFunction(fn);
+    LLVMSetValueName(dcl, name);
+}
+
+// Count the instructions in all of a module's functions
+size_t genlCountInstrs(LLVMModuleRef mod) {
+    size_t cnt = 0;
+    LLVMValueRef fn;
+    LLVMBasicBlockRef blk;
+    LLVMValueRef instr;
+    for (fn = LLVMGetFirstFunction(mod); fn; fn = LLVMGetNextFunction(fn))
+        for (blk = LLVMGetFirstBasicBlock(fn); blk; blk = LLVMGetNextBasicBlock(blk))
+            for (instr = LLVMGetFirstInstruction(blk); instr; instr = LLVMGetNextInstruction(instr))
+                ++cnt;
+    return cnt;
+}
 
+// Context shared with forked codegen unit jobs
+typedef struct GenUnits {
+    GenState *gen;
+    char *fname;
+    int nbr;
+} GenUnits;
+
+// A codegen unit's work: keep every nbr'th externally visible function
+// definition (and, for unit 0, the global variable definitions),
+// turning the rest into declarations. Then optimize and emit its own object file.
+char *genlUnitJob(int index, void *context, size_t *size) {
+    GenUnits *units = (GenUnits*)context;
+    GenState *gen = units->gen;
+    LLVMValueRef glo, next;
+    char unitname[2048];
+    int fnnbr = 0;
+
+    for (glo = LLVMGetFirstFunction(gen->module); glo; glo = next) {
+        next = LLVMGetNextFunction(glo);
+        if (LLVMIsDeclaration(glo) || LLVMGetLinkage(glo) != LLVMExternalLinkage)
+            continue;
+        // Anonymous functions cannot be linked by name, so every unit keeps its own copy
+        if (*LLVMGetValueName(glo) == '\0')
+            LLVMSetLinkage(glo, LLVMInternalLinkage);
+        else if (fnnbr++ % units->nbr != index)
+            genlUnitDropFn(glo);
+    }
+    for (glo = LLVMGetFirstGlobal(gen->module); glo && index != 0; glo = LLVMGetNextGlobal(glo)) {
+        if (!LLVMIsDeclaration(glo) && LLVMGetLinkage(glo) == LLVMExternalLinkage)
+            LLVMSetInitializer(glo, NULL);
+    }
+
+    genlOptimize(gen);
+    if (statsOn)
+        statsLlvmOptInstrs += genlCountInstrs(gen->module);
+    statsPhase(StatsEmit);
+    sprintf(unitname, "%s.%d", units->fname, index);
+    genlEmit(gen, unitname);
+    *size = 0;
+    return errors ? NULL : "";
+}
+
+// Split the module into codegen units, optimizing and emitting each in parallel
+// (or one after another, when forked jobs are unavailable)
+void genlUnits(GenState *gen, char *fname) {
+    GenUnits units;
+    char **results;
+    size_t *sizes;
+    int i, ok;
+
+    units.gen = gen;
+    units.fname = fname;
+    units.nbr = gen->opt->units;
+    results = (char **)memAllocBlk(units.nbr * sizeof(char *));
+    sizes = (size_t *)memAllocBlk(units.nbr * sizeof(size_t));
+    traceBegin("emit", "codegen unit jobs");
+    ok = jobsFork(units.nbr, genlUnitJob, &units, results, sizes);
+    traceEnd();
+
+    // Forked jobs are unavailable: do each unit in turn, on its own copy of the module
+    if (ok < 0) {
+        LLVMModuleRef module = gen->module;
+        for (i = 0; i < units.nbr; ++i) {
+            statsPhase(StatsOptimize);
+            gen->module = LLVMCloneModule(module);
+            genlUnitJob(i, &units, &sizes[i]);
+            LLVMDisposeModule(gen->module);
+        }
+        gen->module = module;
+        return;
+    }
+    if (ok == 0)
+        errorMsg(ErrorGenErr, "Generation of one or more codegen units failed");
+    for (i = 0; i < units.nbr; ++i)
+        free(results[i]);
+}
+
+// Generate IR nodes into LLVM IR using LLVM
+void genmod(GenState *gen, ModuleNode *mod) {
+    // Generate IR to LLVM IR
+    statsPhase(StatsGen);
+    genlPackage(gen, mod);
+    if (statsOn)
+        statsLlvmInstrs = genlCountInstrs(gen->module);
+
+    // Serialize the LLVM IR, if requested
+    if (gen->opt->print_llvmir)
+        genlPrintIr(gen, inodeSrcFile(mod)->fname, "preir");
+
+    // Optimize and emit, either as several codegen units or all at once
+    statsPhase(StatsOptimize);
+    if (gen->opt->units > 1 && gen->machine && !gen->opt->run && !gen->opt->obj_stdout)
+        genlUnits(gen, inodeSrcFile(mod)->fname);
+    else {
+        genlOptimize(gen);
+        if (statsOn)
+            statsLlvmOptInstrs = genlCountInstrs(gen->module);
+        statsPhase(StatsEmit);
+        genlEmit(gen, inodeSrcFile(mod)->fname);
+    }
+
+    // A module to be run is kept for the JIT, which takes ownership of it
+    if (gen->opt->run)
+        return;
     LLVMDisposeModule(gen->module);
     // LLVMContextDispose(gen.context);  // Only need if we created a new context
 }
@@ -348,6 +773,13 @@ void genSetup(GenState *gen, ConeOptions *opt) {
     gen->fn = NULL;
 }
 
+// Keep the target machine warm, for reuse by later compiles with the same settings
+void genWarm(GenState *gen) {
+    genlWarmMachine = gen->machine;
+    genlWarmOpt = *gen->opt;
+}
+
 void genClose(GenState *gen) {
-    LLVMDisposeTargetMachine(gen->machine);
+    if (gen->machine != genlWarmMachine)
+        LLVMDisposeTargetMachine(gen->machine);
 }
\ No newline at end of file
@@ -24,6 +24,7 @@ typedef struct GenState {
     LLVMBuilderRef builder;
     LLVMBasicBlockRef whilebeg;
     LLVMBasicBlockRef whileend;
+    LLVMPassManagerRef fnpassmgr;    // Optimizes each function as soon as it is generated
 
     LLVMDIBuilderRef dibuilder;
     LLVMMetadataRef compileUnit;
@@ -34,11 +35,29 @@ typedef struct GenState {
 
 // Setup LLVM generation, ensuring we know intended target
 void genSetup(GenState *gen, ConeOptions *opt);
+// Keep the target machine warm, for reuse by later compiles with the same settings
+void genWarm(GenState *gen);
 void genClose(GenState *gen);
 void genmod(GenState *gen, ModuleNode *mod);
+// Return the path of the object file to generate for the named module
+char *genlObjPath(GenState *gen, char *fname);
 void genlFn(GenState *gen, FnDclNode *fnnode);
 void genlGloVarName(GenState *gen, VarDclNode *glovar);
 void genlGloFnName(GenState *gen, FnDclNode *glofn);
+// Create and return globally unique name, mangled as necessary
+char *genlGlobalName(INamedNode *name);
+// Turn a function definition into a declaration, redirecting all its uses
+void genlUnitDropFn(LLVMValueRef fn);
+
+// genlinc.c
+// Fingerprint every function, flagging those unchanged since the earlier build for reuse
+void genlIncPrepare(GenState *gen, ModuleNode *mod);
+// Splice in reused function bodies, then save module and fingerprints for the next build
+void genlIncFinish(GenState *gen, ModuleNode *mod);
+
+// genljit.c
+// Compile the generated module in memory and run its main function, returning its result
+int genlJitRun(GenState *gen, int argc, char **argv);
 
 // genlstmt.c
 LLVMBasicBlockRef genlInsertBlock(GenState *gen, char *name);
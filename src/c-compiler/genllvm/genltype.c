@@ -74,15 +74,19 @@ LLVMTypeRef _genlType(GenState *gen, char *name, INode *typ) {
     {
         // Build typeref from function signature
         FnSigNode *fnsig = (FnSigNode*)typ;
-        LLVMTypeRef *param_types = (LLVMTypeRef *)memAllocBlk(fnsig->parms->used * sizeof(LLVMTypeRef));
+        MemMark mark = memScratchMark();
+        LLVMTypeRef *param_types = (LLVMTypeRef *)memScratchAlloc(fnsig->parms->used * sizeof(LLVMTypeRef));
         LLVMTypeRef *parm = param_types;
+        LLVMTypeRef fntype;
         INode **nodesp;
         uint32_t cnt;
         for (nodesFor(fnsig->parms, cnt, nodesp)) {
             assert((*nodesp)->tag == VarDclTag);
             *parm++ = genlType(gen, ((ITypedNode *)*nodesp)->vtype);
         }
-        return LLVMFunctionType(genlType(gen, fnsig->rettype), param_types, fnsig->parms->used, 0);
+        fntype = LLVMFunctionType(genlType(gen, fnsig->rettype), param_types, fnsig->parms->used, 0);
+        memScratchRelease(mark);
+        return fntype;
     }
 
     case StructTag:
@@ -90,22 +94,25 @@ LLVMTypeRef _genlType(GenState *gen, char *name, INode *typ) {
     {
         // Build typeref from struct
         StructNode *strnode = (StructNode*)typ;
-        INode **nodesp;
+        MemRef *nodesp;
         uint32_t cnt;
         uint32_t propcount = 0;
         for (imethnodesFor(&strnode->methprops, cnt, nodesp)) {
-            if ((*nodesp)->tag == VarDclTag)
+            if (imethRefNode(*nodesp)->tag == VarDclTag)
                 ++propcount;
         }
-        LLVMTypeRef *prop_types = (LLVMTypeRef *)memAllocBlk(propcount * sizeof(LLVMTypeRef));
+        MemMark mark = memScratchMark();
+        LLVMTypeRef *prop_types = (LLVMTypeRef *)memScratchAlloc(propcount * sizeof(LLVMTypeRef));
         LLVMTypeRef *property = prop_types;
         for (imethnodesFor(&strnode->methprops, cnt, nodesp)) {
-            if ((*nodesp)->tag == VarDclTag)
-                *property++ = genlType(gen, ((ITypedNode *)*nodesp)->vtype);
+            INode *prop = imethRefNode(*nodesp);
+            if (prop->tag == VarDclTag)
+                *property++ = genlType(gen, ((ITypedNode *)prop)->vtype);
         }
         LLVMTypeRef structype = LLVMStructCreateNamed(gen->context, name);
         if (propcount > 0)
             LLVMStructSetBody(structype, prop_types, propcount, 0);
+        memScratchRelease(mark);
         return structype;
     }
 
@@ -116,12 +123,16 @@ LLVMTypeRef _genlType(GenState *gen, char *name, INode *typ) {
         INode **nodesp;
         uint32_t cnt;
         uint32_t propcount = tuple->types->used;
-        LLVMTypeRef *typerefs = (LLVMTypeRef *)memAllocBlk(propcount * sizeof(LLVMTypeRef));
+        MemMark mark = memScratchMark();
+        LLVMTypeRef *typerefs = (LLVMTypeRef *)memScratchAlloc(propcount * sizeof(LLVMTypeRef));
         LLVMTypeRef *typerefp = typerefs;
+        LLVMTypeRef structype;
         for (nodesFor(tuple->types, cnt, nodesp)) {
             *typerefp++ = genlType(gen, *nodesp);
         }
-        return LLVMStructTypeInContext(gen->context, typerefs, propcount, 0);
+        structype = LLVMStructTypeInContext(gen->context, typerefs, propcount, 0);
+        memScratchRelease(mark);
+        return structype;
     }
 
     case ArrayTag:
@@ -150,17 +161,19 @@ LLVMTypeRef genlType(GenState *gen, INode *typ) {
         LLVMTypeRef typeref = dclnode->llvmtype = _genlType(gen, &dclnode->namesym->namestr, (INode*)dclnode);
         if (isMethodType(dclnode)) {
             IMethodNode *tnode = (IMethodNode*)dclnode;
-            INode **nodesp;
+            MemRef *nodesp;
             uint32_t cnt;
             // Declare just method names first, enabling forward references
             for (imethnodesFor(&tnode->methprops, cnt, nodesp)) {
-                if ((*nodesp)->tag == FnDclTag)
-                    genlGloFnName(gen, (FnDclNode*)*nodesp);
+                INode *meth = imethRefNode(*nodesp);
+                if (meth->tag == FnDclTag)
+                    genlGloFnName(gen, (FnDclNode*)meth);
             }
             // Now generate the code for each method
             for (imethnodesFor(&tnode->methprops, cnt, nodesp)) {
-                if ((*nodesp)->tag == FnDclTag)
-                    genlFn(gen, (FnDclNode*)*nodesp);
+                INode *meth = imethRefNode(*nodesp);
+                if (meth->tag == FnDclTag)
+                    genlFn(gen, (FnDclNode*)meth);
             }
         }
         return typeref;
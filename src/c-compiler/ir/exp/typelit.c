@@ -98,13 +98,13 @@ int typeLitGetName(Nodes *args, uint32_t argi, Name *name) {
 // Type check a struct literal
 // Verify correct name/type of each literal element against struct's properties
 void typeLitStructCheck(PassState *pstate, FnCallNode *arrlit, StructNode *strnode) {
-    INode **nodesp;
+    MemRef *nodesp;
     uint32_t cnt;
     uint32_t argi = 0;
     for (imethnodesFor(&strnode->methprops, cnt, nodesp)) {
-        if ((*nodesp)->tag != VarDclTag)
+        VarDclNode *prop = (VarDclNode *)imethRefNode(*nodesp);
+        if (prop->tag != VarDclTag)
             continue;
-        VarDclNode *prop = (VarDclNode *)*nodesp;
 
         // If element has been specified, be sure it matches both name & type
         if (argi < arrlit->args->used) {
@@ -114,7 +114,7 @@ void typeLitStructCheck(PassState *pstate, FnCallNode *arrlit, StructNode *strno
                 ++argi;
                 continue;
             }
-            if (!iexpSameType(*nodesp, litval))
+            if (!iexpSameType((INode*)prop, litval))
                 errorMsgNode((INode*)*litval, ErrorBadArray, "Literal value's type does not match expected field's type");
         }
         // Append default value if no value specified
@@ -183,6 +183,7 @@ void flowAddVar(VarDclNode *varnode) {
             gVarFlowStackp = (VarFlowInfo*)memAllocBlk(gVarFlowStackSz * sizeof(VarFlowInfo));
             memset(gVarFlowStackp, 0, gVarFlowStackSz * sizeof(VarFlowInfo));
             memcpy(gVarFlowStackp, oldtable, oldsize * sizeof(VarFlowInfo));
+            memFreeBlk(oldtable, oldsize * sizeof(VarFlowInfo));
         }
     }
     VarFlowInfo *stackp = &gVarFlowStackp[gVarFlowStackPos++];
@@ -250,6 +251,7 @@ void flowAliasRoom(size_t highpos) {
             gFlowAliasStackp = (int16_t*)memAllocBlk(gFlowAliasStackSz * sizeof(int16_t));
             memset(gFlowAliasStackp, 0, gFlowAliasStackSz * sizeof(int16_t));
             memcpy(gFlowAliasStackp, oldtable, oldsize * sizeof(int16_t));
+            memFreeBlk(oldtable, oldsize * sizeof(int16_t));
         }
     }
 }
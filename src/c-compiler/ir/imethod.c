@@ -15,27 +15,28 @@
 void imethnodesInit(IMethNodes *mnodes, uint32_t size) {
     mnodes->avail = size;
     mnodes->used = 0;
-    mnodes->nodes = (INode **)memAllocBlk(size * sizeof(INode **));
+    mnodes->nodes = (MemRef *)memAllocBlk(size * sizeof(MemRef));
 }
 
 // Double size, if full
 void methnodesGrow(IMethNodes *mnodes) {
-    INode **oldnodes;
+    MemRef *oldnodes;
     oldnodes = mnodes->nodes;
     mnodes->avail <<= 1;
-    mnodes->nodes = (INode **)memAllocBlk(mnodes->avail * sizeof(INode **));
-    memcpy(mnodes->nodes, oldnodes, mnodes->used * sizeof(INode **));
+    mnodes->nodes = (MemRef *)memAllocBlk(mnodes->avail * sizeof(MemRef));
+    memcpy(mnodes->nodes, oldnodes, mnodes->used * sizeof(MemRef));
 }
 
 // Find the desired named node.
 // Return the node, if found or NULL if not found
 INamedNode *imethnodesFind(IMethNodes *mnodes, Name *name) {
-    INode **nodesp;
+    MemRef *refp;
     uint32_t cnt;
-    for (imethnodesFor(mnodes, cnt, nodesp)) {
-        if (isNamedNode(*nodesp)) {
-            if (((INamedNode*)*nodesp)->namesym == name)
-                return (INamedNode*)*nodesp;
+    for (imethnodesFor(mnodes, cnt, refp)) {
+        INode *node = imethRefNode(*refp);
+        if (isNamedNode(node)) {
+            if (((INamedNode*)node)->namesym == name)
+                return (INamedNode*)node;
         }
     }
     return NULL;
@@ -45,7 +46,7 @@ INamedNode *imethnodesFind(IMethNodes *mnodes, Name *name) {
 void imethnodesAdd(IMethNodes *mnodes, INode *node) {
     if (mnodes->used >= mnodes->avail)
         methnodesGrow(mnodes);
-    mnodes->nodes[mnodes->used++] = node;
+    mnodes->nodes[mnodes->used++] = memRef(node);
 }
 
 // Add a function or potentially overloaded method
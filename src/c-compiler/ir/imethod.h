@@ -9,13 +9,17 @@
 #define imethod_h
 
 // Variable-sized structure holding an ordered list of Nodes
-// These nodes are methods (potentially overloaded) or properties
+// These nodes are methods (potentially overloaded) or properties,
+// held as compact references (see memRef): use imethRefNode to get a node.
 typedef struct IMethNodes {
     uint32_t used;
     uint32_t avail;
-    INode **nodes;
+    MemRef *nodes;
 } IMethNodes;
 
+// Get the node a method/property reference refers to
+#define imethRefNode(ref) ((INode *)memDeref(ref))
+
 // Named type that supports methods, properties and traits
 #define IMethodNodeHdr \
     INamedTypeNodeHdr; \
@@ -36,11 +40,11 @@ typedef struct VarDclNode VarDclNode;
 // Initialize methnodes metadata in a method type node
 void imethnodesInit(IMethNodes *mnodes, uint32_t size);
 
-// Iterate through the set of IMethNodes 
-#define imethnodesFor(mnodes, cnt, nodesp) nodesp = (mnodes)->nodes, cnt = (mnodes)->used; cnt; cnt--, nodesp++
+// Iterate through the set of IMethNodes (refp is a MemRef *)
+#define imethnodesFor(mnodes, cnt, refp) refp = (mnodes)->nodes, cnt = (mnodes)->used; cnt; cnt--, refp++
 
 // Point to the indexth node in an IMethNodes
-#define imethnodesGet(mnodes, index) (mnodes)->nodes[index]
+#define imethnodesGet(mnodes, index) imethRefNode((mnodes)->nodes[index])
 
 // Point to the last node in an IMethNodes
 #define imethnodesLast(mnodes) imethnodesGet(mnodes, mnodes->used-1)
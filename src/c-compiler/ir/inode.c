@@ -15,6 +15,62 @@
 #include <stdarg.h>
 #include <assert.h>
 
+// Return the name of a node's tag (e.g., "FnDcl" for FnDclTag)
+char *inodeTagName(uint16_t tag) {
+    switch (tag) {
+    case IntrinsicTag: return "Intrinsic";
+    case ReturnTag: return "Return";
+    case BlockRetTag: return "BlockRet";
+    case WhileTag: return "While";
+    case BreakTag: return "Break";
+    case ContinueTag: return "Continue";
+    case NameUseTag: return "NameUse";
+    case ModuleTag: return "Module";
+    case VarDclTag: return "VarDcl";
+    case FnDclTag: return "FnDcl";
+    case VarNameUseTag: return "VarNameUse";
+    case MbrNameUseTag: return "MbrNameUse";
+    case ULitTag: return "ULit";
+    case FLitTag: return "FLit";
+    case NullTag: return "Null";
+    case StrLitTag: return "StrLit";
+    case TypeLitTag: return "TypeLit";
+    case VTupleTag: return "VTuple";
+    case AssignTag: return "Assign";
+    case FnCallTag: return "FnCall";
+    case ArrIndexTag: return "ArrIndex";
+    case StrFieldTag: return "StrField";
+    case SizeofTag: return "Sizeof";
+    case CastTag: return "Cast";
+    case BorrowTag: return "Borrow";
+    case AllocateTag: return "Allocate";
+    case DerefTag: return "Deref";
+    case NotLogicTag: return "NotLogic";
+    case OrLogicTag: return "OrLogic";
+    case AndLogicTag: return "AndLogic";
+    case BlockTag: return "Block";
+    case IfTag: return "If";
+    case AliasTag: return "Alias";
+    case NamedValTag: return "NamedVal";
+    case TypeNameUseTag: return "TypeNameUse";
+    case FnSigTag: return "FnSig";
+    case ArrayTag: return "Array";
+    case RefTag: return "Ref";
+    case ArrayRefTag: return "ArrayRef";
+    case ArrayDerefTag: return "ArrayDeref";
+    case PtrTag: return "Ptr";
+    case TTupleTag: return "TTuple";
+    case VoidTag: return "Void";
+    case IntNbrTag: return "IntNbr";
+    case UintNbrTag: return "UintNbr";
+    case FloatNbrTag: return "FloatNbr";
+    case StructTag: return "Struct";
+    case PermTag: return "Perm";
+    case AllocTag: return "Alloc";
+    default: return "?";
+    }
+}
+
 // State for inodePrint
 FILE *irfile;
 int irIndent=0;
@@ -158,7 +214,7 @@ void inodePrintNode(INode *node) {
 
 // Serialize the program's IR to dir+srcfn
 void inodePrint(char *dir, char *srcfn, INode *pgmnode) {
-    irfile = fopen(fileMakePath(dir, pgmnode->lexer->fname, "ast"), "wb");
+    irfile = fopen(fileMakePath(dir, inodeSrcFile(pgmnode)->fname, "ast"), "wb");
     inodePrintNode(pgmnode);
     fclose(irfile);
 }
@@ -3,7 +3,7 @@
 * All IR nodes begin with header fields that specify
 * - Which specific node it is, and what node groups it belongs to
 * - Node-specific flags distinguishing variations
-* - Lexer position info, to improve the helpfulness of error messages
+* - Source location, to improve the helpfulness of error messages
 *
 * All nodes can be channeled through helpful functions:
 * - Dispatch for the semantic passes
@@ -18,19 +18,14 @@
 #ifndef inode_h
 #define inode_h
 
-// All IR nodes begin with this header, mostly containing lexer data describing
+// All IR nodes begin with this header, describing the node and
 // where in the source this structure came from (useful for error messages)
+// - srcloc is the source location of the node's source token (see shared/srcloc.h).
+//   Use inodeSrcFile, inodeSrcPtr and inodeLine to decode it.
 // - tag contains the NodeTags code
 // - flags contains node-specific flags
-// - lexer contains -> url (filepath) and -> source
-// - srcp points to start of source token
-// - linep points to start of line that token begins on
-// - linenbr is the source file's line number, starting with 1
 #define INodeHdr \
-    Lexer *lexer; \
-    char *srcp; \
-    char *linep; \
-    uint32_t linenbr; \
+    uint32_t srcloc; \
     uint16_t tag; \
     uint16_t flags
 
@@ -55,12 +50,8 @@ typedef struct INode {
 
 // All the possible tags for a node
 enum NodeTags {
-    // Lexer-only nodes that are *never* found in a program's IR.
-    // KeywordTag exists for name table consistency
-    KeywordTag = StmtGroup,    // Keyword token (flags is the keyword's token type)
-
     // Untyped (Basic) nodes
-    IntrinsicTag,   // Alternative to fndcl block for internal operations (e.g., add)
+    IntrinsicTag = StmtGroup,   // Alternative to fndcl block for internal operations (e.g., add)
     ReturnTag,      // Return node
     BlockRetTag,    // Block "return" node. Injected by flow pass for de-aliasing.
     WhileTag,       // While node
@@ -128,6 +119,7 @@ enum NodeTags {
 #define FlagExtern    0x0002        // FnDcl, VarDcl: C ABI extern (no value, no mangle)
 #define FlagSystem    0x0004        // FnDcl: imported system call (+stdcall on Winx86)
 #define FlagSetMethod 0x0008        // FnDcl: "set" method
+#define FlagReuse     0x0010        // FnDcl: reuse body generated by an earlier incremental build
 
 #define FlagIndex     0x0001        // FnCall: arguments are an index in []
 #define FlagLvalOp    0x0002        // FnCall: method is an operator assignment (e.g., +=)
@@ -135,26 +127,33 @@ enum NodeTags {
 
 #define FlagSuffix    0x0001        // Borrow: part of a borrow chain
 
+#define FlagParseFile 0x0001        // Module: its file is parsed on a pool thread (a ParseFile)
+#define FlagInclude   0x0002        // Module: stands in for an included file's nodes, until parsed
+
 
 // Allocate and initialize the INode portion of a new node
 #define newNode(node, nodestruct, nodetype) {\
     node = (nodestruct*) memAllocBlk(sizeof(nodestruct)); \
+    statsCountNode(nodetype); \
     node->tag = nodetype; \
     node->flags = 0; \
-    node->lexer = lex; \
-    node->srcp = lex->tokp; \
-    node->linep = lex->linep; \
-    node->linenbr = lex->linenbr; \
+    node->srcloc = lexSrcLoc(); \
 }
 
 // Copy lexer info over to another node
 #define copyNodeLex(newnode, oldnode) { \
-    (newnode)->lexer = (oldnode)->lexer; \
-    (newnode)->srcp = (oldnode)->srcp; \
-    (newnode)->linep = (oldnode)->linep; \
-    (newnode)->linenbr = (oldnode)->linenbr; \
+    (newnode)->srcloc = (oldnode)->srcloc; \
 }
 
+// Decode a node's source location: its source file, its token in the source text,
+// and its line number (also returning where the line starts, if linep is not NULL)
+#define inodeSrcFile(node) srclocFile((node)->srcloc)
+#define inodeSrcPtr(node) srclocPtr((node)->srcloc)
+#define inodeLine(node, linep) srclocLine((node)->srcloc, linep)
+
+// Return the name of a node's tag (e.g., "FnDcl" for FnDclTag)
+char *inodeTagName(uint16_t tag);
+
 // Helper functions for serializing a node
 void inodePrint(char *dir, char *srcfn, INode *pgm);
 void inodePrintNode(INode *node);
@@ -29,6 +29,9 @@
 #include <stdint.h>
 
 #include "../shared/memory.h"
+#include "../shared/srcloc.h"
+#include "../shared/stats.h"
+#include "../shared/trace.h"
 #include "nodes.h"
 #include "namespace.h"
 typedef struct Name Name;        // ../nametbl.h
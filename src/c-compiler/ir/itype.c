@@ -122,9 +122,10 @@ int itypeCopyTrait(INode *typenode) {
         int copytrait = CopyBitwise;
         IMethNodes *nodes = &((IMethodNode *)typenode)->methprops;
         uint32_t cnt;
-        INode **nodesp;
+        MemRef *nodesp;
         for (imethnodesFor(nodes, cnt, nodesp)) {
-            if (((*nodesp)->tag == VarDclTag && CopyBitwise != itypeCopyTrait(*nodesp))
+            INode *prop = imethRefNode(*nodesp);
+            if ((prop->tag == VarDclTag && CopyBitwise != itypeCopyTrait(prop))
                 /* || *nodesp points to a destructor */)
                 copytrait == CopyBitwise ? CopyMove : copytrait;
             // else if (nodesp points to the .copy method)
@@ -10,85 +10,46 @@
 #include "memory.h"
 
 #include <stdio.h>
-#include <assert.h>
 #include <string.h>
 
-/** Modulo operation that calculates primary table entry from name's hash.
-* 'size' is always a power of 2 */
-#define nameHashMod(hash, size) \
-    (assert(((size)&((size)-1))==0), (size_t) ((hash) & ((size)-1)) )
-
-// Find the NameNode slot owned by a name
-#define namespaceFindSlot(slot, ns, namep) \
+// Find the index of the NameNode slot owned by a name: found is 1 if it is there
+#define namespaceFindSlot(tbli, found, ns, namep) \
 { \
-    size_t tbli, step; \
-    for (tbli = nameHashMod((namep)->hash, (ns)->avail), step = 1;; ++step) { \
-        slot = &(ns)->namenodes[tbli]; \
-        if (slot->name == NULL || slot->name == (namep)) \
-            break; \
-        tbli = nameHashMod(tbli + step, (ns)->avail); \
-    } \
+    MemRef nameref = memRef(namep); \
+    hashTblFind(&(ns)->tbl, (namep)->hash, tbli, found, \
+        hashTblSlot(&(ns)->tbl, tbli, NameNode)->name == nameref); \
 }
 
-// Grow the namespace, by either creating it or doubling its size
-void namespaceGrow(Namespace *namespace) {
-    size_t oldTblAvail;
-    NameNode *oldTable;
-    size_t newTblMem;
-    size_t oldslot;
-
-    // Use avail for new table, otherwise double its size
-    if (namespace->used == 0) {
-        oldTblAvail = 0;
-    }
-    else {
-        oldTblAvail = namespace->avail;
-        namespace->avail <<= 1;
-    }
-
-    // Allocate and initialize new name table
-    oldTable = namespace->namenodes;
-    newTblMem = namespace->avail * sizeof(NameNode);
-    namespace->namenodes = (NameNode*)memAllocBlk(newTblMem);
-    memset(namespace->namenodes, 0, newTblMem);
-
-    // Copy existing name slots to re-hashed positions in new table
-    for (oldslot = 0; oldslot < oldTblAvail; oldslot++) {
-        NameNode *oldslotp, *newslotp;
-        oldslotp = &oldTable[oldslot];
-        if (oldslotp->name) {
-            namespaceFindSlot(newslotp, namespace, oldslotp->name);
-            newslotp->name = oldslotp->name;
-            newslotp->node = oldslotp->node;
-        }
-    }
-    // memFreeBlk(oldTable);
+// Return the hash of the name in a namespace slot
+static size_t namespaceSlotHash(void *slot) {
+    return ((Name *)memDeref(((NameNode *)slot)->name))->hash;
 }
 
 // Initialize a namespace with a specific number of slots
 void namespaceInit(Namespace *ns, size_t avail) {
-    ns->used = 0;
-    ns->avail = avail;
-    ns->namenodes = NULL;
-    namespaceGrow(ns);
+    hashTblInit(&ns->tbl, avail, sizeof(NameNode));
 }
 
 // Return the node for a name (or NULL if none)
 INamedNode *namespaceFind(Namespace *ns, Name *name) {
-    NameNode *slotp;
-    namespaceFindSlot(slotp, ns, name);
-    return slotp->node;
+    size_t tbli;
+    int found;
+    namespaceFindSlot(tbli, found, ns, name);
+    return found ? (INamedNode *)memDeref(hashTblSlot(&ns->tbl, tbli, NameNode)->node) : NULL;
 }
 
 // Add or change the node a name maps to
 void namespaceSet(Namespace *ns, Name *name, INamedNode *node) {
-    size_t cap = (ns->avail * 100) >> 7;
-    if (ns->used > cap)
-        namespaceGrow(ns);
+    size_t tbli;
+    int found;
     NameNode *slotp;
-    namespaceFindSlot(slotp, ns, name);
-    if (slotp->node == NULL)
-        ++ns->used;
-    slotp->name = name;
-    slotp->node = node;
+    if (hashTblFull(&ns->tbl))
+        hashTblGrow(&ns->tbl, namespaceSlotHash);
+    namespaceFindSlot(tbli, found, ns, name);
+    slotp = hashTblSlot(&ns->tbl, tbli, NameNode);
+    if (!found) {
+        hashTblClaim(&ns->tbl, tbli, name->hash);
+        slotp->name = memRef(name);
+    }
+    slotp->node = memRef(node);
 }
@@ -10,17 +10,18 @@
 
 typedef struct Name Name;
 
-// A namespace entry
+#include "../shared/hashtbl.h"
+
+// A namespace entry. The name and node are compact references (see memRef),
+// so that (with CONE_COMPRESSED_IR) twice as many entries fit in a cache line.
 typedef struct NameNode {
-    Name *name;
-    INamedNode *node;
+    MemRef name;    // Name *
+    MemRef node;    // INamedNode *
 } NameNode;
 
-// Namespace metadata
+// Namespace metadata: a hash table of NameNode slots
 typedef struct Namespace {
-    size_t avail;
-    size_t used;
-    NameNode *namenodes;
+    HashTbl tbl;
 } Namespace;
 
 void namespaceInit(Namespace *ns, size_t avail);
@@ -30,10 +31,9 @@ void namespaceSet(Namespace *ns, Name *name, INamedNode *node);
 // When multiple exist, they are mediated by a FnTupleNode
 void namespaceAddFnTuple(Namespace *ns, INamedNode *fn);
 
-#define namespaceFor(ns) for (size_t __i = 0; __i < (ns)->avail; ++__i)
+#define namespaceFor(ns) for (size_t __i = 0; __i < (ns)->tbl.avail; ++__i)
 #define namespaceNextNode(ns, nodevar) \
-  NameNode *__namenodep = &(ns)->namenodes[__i]; \
-  if (__namenodep->name == NULL) continue; \
-  nodevar = __namenodep->node;
+  if (hashTblEmpty(&(ns)->tbl, __i)) continue; \
+  nodevar = (INamedNode *)memDeref(hashTblSlot(&(ns)->tbl, __i, NameNode)->node);
 
 #endif
\ No newline at end of file
@@ -5,142 +5,374 @@
  * Every name is immutable and uniquely hashed based on its string characters.
  *
  * All names are hashed and stored in the global name table.
+ * Reserved names (keywords, permissions, etc.) are the exception: they are interned
+ * up front, and recognized by a perfect hash generated at build time (see parser/keywords.h).
  * The name's table entry points to an allocated block that holds its current "value", computed hash and c-string.
  *
- * Dan Bernstein's djb algorithm is the hash function for strings, being fast and effective
- * The name table uses open addressing (vs. chaining) with quadratic probing (no Robin Hood).
+ * Names are hashed a word at a time (wyhash), which is fast and well-mixed even for short names.
+ * The name table is an open-addressing hash table probed a group of slots at a time (see hashtbl.h).
  * The name table starts out large, but will double in size whenever it gets close to full.
  *
+ * Several threads may intern names at once, without locks. A name is added by
+ * compare-and-swap of its pointer into an empty slot; the slot's control byte is set
+ * after, so it is only a hint (a slot with an "empty" byte may already hold a name).
+ * To double in size, a new table is chained on to the full one. Any thread that interns
+ * a name then helps migrate a chunk of the old table's names over, until it is retired.
+ * Meanwhile, lookups and additions go on, walking from the oldest table to the newest.
+ * No name is ever moved or duplicated, so each name's Name* stays unique.
+ *
  * This source file is part of the Cone Programming Language C compiler
  * See Copyright Notice in conec.h
 */
 
 #include "nametbl.h"
 #include "memory.h"
+#include "../shared/hashtbl.h"
+#include "../parser/lexer.h"
+#include "../parser/keywords.h"
+#include "keywordtbl.h"    // Generated by parser/genkeywords.c
 
 #include <stdio.h>
+#include <stdint.h>
 #include <assert.h>
 #include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Thread-safe compare-and-swap, acquiring load and fetch-and-add on a pointer-sized
+// value, releasing store of a byte, relaxed load of a size and acquiring load of
+// 8 control bytes. (MSVC's volatile accesses only acquire and release on x86/x64.)
+#ifdef _MSC_VER
+#define nameCas(ptr, old, new) (InterlockedCompareExchangePointer((PVOID volatile *)(ptr), (PVOID)(new), (PVOID)(old)) == (PVOID)(old))
+#define nameLoad(ptr) ReadPointerAcquire((PVOID const volatile *)(ptr))
+#define nameLoadSize(ptr) (*(volatile size_t *)(ptr))
+#define nameLoad64(ptr) ((uint64_t)ReadAcquire64((LONG64 const volatile *)(ptr)))
+#define nameAdd(ptr, n) ((size_t)InterlockedExchangeAdd64((LONG64 volatile *)(ptr), (LONG64)(n)))
+#define nameStoreByte(ptr, val) (*(volatile uint8_t *)(ptr) = (val))
+#else
+#define nameCas(ptr, old, new) __sync_bool_compare_and_swap((ptr), (old), (new))
+#define nameLoad(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define nameLoadSize(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define nameLoad64(ptr) __atomic_load_n((uint64_t *)(ptr), __ATOMIC_ACQUIRE)
+#define nameAdd(ptr, n) __atomic_fetch_add((ptr), (n), __ATOMIC_ACQ_REL)
+#define nameStoreByte(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#endif
+
+// A name table, chained to the bigger one that replaces it once it is full
+typedef struct NameTbl {
+    struct NameTbl *next;    // Table names migrate to (NULL until this one fills)
+    size_t avail;            // Number of slots (power of 2)
+    size_t used;             // Number of slots holding a name
+    size_t migrate;          // Start of the next chunk of slots to migrate
+    size_t migrated;         // Number of slots done migrating
+    uint8_t *ctrl;           // Control bytes (see hashtbl.h)
+    Name **slots;            // Interned name, NameMoved, or NULL if empty
+} NameTbl;
+
+// Marks an empty slot of a table being migrated: its names go in the next table
+#define NameMoved ((Name *)1)
+
+// Number of slots migrated by a thread at a time
+#define NameMigrateChunk 256
 
 // Public globals
 size_t gNameTblInitSize = 16384;    // Initial maximum number of unique names (must be power of 2)
-unsigned int gNameTblUtil = 80;        // % utilization that triggers doubling of table
 
 // Private globals
-Name **gNameTable = NULL;        // The name table array
-size_t gNameTblAvail = 0;        // Number of allocated name table slots (power of 2)
-size_t gNameTblCeil = 0;        // Ceiling that triggers table growth
-size_t gNameTblUsed = 0;        // Number of name table slots used
-
-/** String hash function (djb: Dan Bernstein)
- * Ref: http://www.cse.yorku.ca/~oz/hash.html
- * Ref: http://www.partow.net/programming/hashfunctions/#AvailableHashFunctions
- * Would this help?: hash ^= hash >> 11; // Extra randomness for long names?
- */
-#define nameHashFn(hash, strp, strl) \
-{ \
-    char *p; \
-    size_t len = strl; \
-    p = strp; \
-    hash = 5381; \
-    while (len--) \
-        hash = ((hash << 5) + hash) ^ ((size_t)*p++); \
+NameTbl *gNameTable = NULL;    // Oldest name table still in use (newer ones chain from it)
+Name *gKeywordNames[sizeof(keywordTbl) / sizeof(Keyword)];    // Interned reserved names
+
+// Read 8, 4 or 1-3 bytes from an unaligned position
+static uint64_t nameRd8(const char *p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static uint64_t nameRd4(const char *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static uint64_t nameRd3(const unsigned char *p, size_t len) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+}
+
+// Multiply two 64-bit values, leaving the 128-bit product's low half in a, high in b
+static void nameMum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
 }
 
-/** Modulo operation that calculates primary table entry from name's hash.
- * 'size' is always a power of 2 */
-#define nameHashMod(hash, size) \
-    (assert(((size)&((size)-1))==0), (size_t) ((hash) & ((size)-1)) )
-
-/** Calculate index into name table for a name using quadratic probing
- * The table's slot at index is either empty or matches the provided name/hash
- * http://stackoverflow.com/questions/2348187/moving-from-linear-probing-to-quadratic-probing-hash-collisons/2349774#2349774
- */
-#define nametblFindSlot(tblp, hash, strp, strl) \
-{ \
-    size_t tbli, step; \
-    for (tbli = nameHashMod(hash, gNameTblAvail), step = 1;; ++step) { \
-        Name *slot; \
-        slot = gNameTable[tbli]; \
-        if (slot==NULL || (slot->hash == hash && slot->namesz == strl && strncmp(strp, &slot->namestr, strl)==0)) \
-            break; \
-        tbli = nameHashMod(tbli + step, gNameTblAvail); \
-    } \
-    tblp = &gNameTable[tbli]; \
+// Multiply two 64-bit values, then fold the product's halves together
+static uint64_t nameMix(uint64_t a, uint64_t b) {
+    nameMum(&a, &b);
+    return a ^ b;
 }
 
-/** Grow the name table, by either creating it or doubling its size */
-void nametblGrow() {
-    size_t oldTblAvail;
-    Name **oldTable;
-    size_t newTblMem;
-    size_t oldslot;
-
-    // Preserve old table info
-    oldTable = gNameTable;
-    oldTblAvail = gNameTblAvail;
-
-    // Allocate and initialize new name table
-    gNameTblAvail = oldTblAvail==0? gNameTblInitSize : oldTblAvail<<1;
-    gNameTblCeil = (gNameTblUtil * gNameTblAvail) / 100;
-    newTblMem = gNameTblAvail * sizeof(Name*);
-    gNameTable = (Name**) memAllocBlk(newTblMem);
-    memset(gNameTable, 0, newTblMem); // Fill with NULL pointers & 0s
-
-    // Copy existing name slots to re-hashed positions in new table
-    for (oldslot=0; oldslot < oldTblAvail; oldslot++) {
-        Name **oldslotp, **newslotp;
-        oldslotp = &oldTable[oldslot];
-        if (*oldslotp) {
-            char *strp;
-            size_t strl, hash;
-            Name *oldnamep = *oldslotp;
-            strp = &oldnamep->namestr;
-            strl = oldnamep->namesz;
-            hash = oldnamep->hash;
-            nametblFindSlot(newslotp, hash, strp, strl);
-            *newslotp = *oldslotp;
+/** String hash function (wyhash, final version 4, with its default secret)
+ * Ref: https://github.com/wangyi-fudan/wyhash
+ * Names up to 16 characters (nearly all of them) take only overlapping word reads
+ * and two multiplies. Longer ones are mixed 16 bytes at a time in a single lane
+ * (wyhash uses three lanes past 48 bytes). It never reads outside the string. */
+static size_t nameHash(char *strp, size_t strl) {
+    static const uint64_t s0 = 0xa0761d6478bd642full, s1 = 0xe7037ed1a0b428dbull;
+    const unsigned char *p = (const unsigned char *)strp;
+    uint64_t seed = nameMix(s0, s1);    // Seed 0, premixed as wyhash does
+    uint64_t a, b;
+    if (strl <= 16) {
+        if (strl >= 4) {
+            size_t mid = (strl >> 3) << 2;
+            a = (nameRd4(strp) << 32) | nameRd4(strp + mid);
+            b = (nameRd4(strp + strl - 4) << 32) | nameRd4(strp + strl - 4 - mid);
+        }
+        else if (strl > 0) {
+            a = nameRd3(p, strl);
+            b = 0;
+        }
+        else
+            a = b = 0;
+    }
+    else {
+        size_t i = strl;
+        char *q = strp;
+        while (i > 16) {
+            seed = nameMix(nameRd8(q) ^ s1, nameRd8(q + 8) ^ seed);
+            i -= 16;
+            q += 16;
         }
+        a = nameRd8(q + i - 16);
+        b = nameRd8(q + i - 8);
     }
-    // memFreeBlk(oldTable);
+    a ^= s1;
+    b ^= seed;
+    nameMum(&a, &b);
+    return (size_t)nameMix(a ^ s0 ^ strl, b ^ s1);
+}
+
+// Allocate a name table with avail empty slots
+static NameTbl *nametblNew(size_t avail) {
+    NameTbl *tbl = (NameTbl *)memAllocBlk(sizeof(NameTbl) + avail * (sizeof(Name *) + 1));
+    tbl->next = NULL;
+    tbl->avail = avail;
+    tbl->used = tbl->migrate = tbl->migrated = 0;
+    tbl->slots = (Name **)(tbl + 1);
+    tbl->ctrl = (uint8_t *)(tbl->slots + avail);
+    memset(tbl->slots, 0, avail * sizeof(Name *));
+    memset(tbl->ctrl, HashEmpty, avail);
+    return tbl;
+}
+
+// Chain a table twice the size on to a full table (unless another thread already has)
+static void nametblGrow(NameTbl *tbl) {
+    NameTbl *next = nametblNew(tbl->avail << 1);
+    if (!nameCas(&tbl->next, NULL, next))
+        memFreeBlk(next, sizeof(NameTbl) + next->avail * (sizeof(Name *) + 1));
+}
+
+// Allocate and populate a new name
+static Name *nametblNewName(char *strp, size_t strl, size_t hash) {
+    Name *newname = memAllocBlk(sizeof(Name) + strl);
+    memcpy(&newname->namestr, strp, strl);
+    (&newname->namestr)[strl] = '\0';
+    newname->hash = hash;
+    newname->namesz = (unsigned char)strl;
+    newname->node = NULL;        // Node not yet known
+    return newname;
+}
+
+/** Look for a name in a table, adding it if absent (unless the table is being migrated).
+ * If strp is NULL, *newname is an already-interned name that is migrating to this table.
+ * Otherwise, a new name for the string is allocated into *newname when it is to be added.
+ * Return the interned name, or NULL if the name belongs in the next table. */
+static Name *nametblProbe(NameTbl *tbl, size_t hash, char *strp, size_t strl, Name **newname) {
+    NameTbl *next = nameLoad(&tbl->next);
+    size_t grpmask = (tbl->avail / HashGroup) - 1;
+    size_t grp = (hash >> 7) & grpmask, step;
+    uint8_t tag = (uint8_t)(hash & 0x7f);
+    Name *name;
+
+#define nametblMatch(name) (strp ? (name)->hash == hash && (name)->namesz == strl \
+    && memcmp(strp, &(name)->namestr, strl) == 0 : (name) == *newname)
+
+    // Probe every group once, quadratically
+    for (step = 0; step <= grpmask; grp = (grp + ++step) & grpmask) {
+        // Take one snapshot of the group's control bytes, as other threads may set them
+        // (the control bytes follow the slots, so each group's are 8-byte aligned).
+        // Loading them with acquire makes the name stored before a tag visible too.
+        uint64_t grpctrl64[HashGroup / 8];
+        uint8_t *grpctrl = (uint8_t *)grpctrl64;
+        unsigned bits;
+        grpctrl64[0] = nameLoad64(&tbl->ctrl[grp * HashGroup]);
+        grpctrl64[1] = nameLoad64(&tbl->ctrl[grp * HashGroup + 8]);
+
+        // Check names whose control byte matches the hash
+        for (bits = hashGroupMatch(grpctrl, tag); bits; bits &= bits - 1) {
+            name = nameLoad(&tbl->slots[grp * HashGroup + hashCtz(bits)]);
+            if (name == NULL || name == NameMoved)
+                continue;
+            if (nametblMatch(name))
+                return name;
+        }
+
+        // Claim the group's first empty slot (or mark it moved, if migrating).
+        // If another thread beat us to it, see what they put there.
+        for (bits = hashGroupEmpty(grpctrl); bits; bits &= bits - 1) {
+            size_t tbli = grp * HashGroup + hashCtz(bits);
+            name = nameLoad(&tbl->slots[tbli]);
+            if (name == NULL) {
+                Name *claim = next ? NameMoved
+                    : *newname ? *newname : (*newname = nametblNewName(strp, strl, hash));
+                if (nameCas(&tbl->slots[tbli], NULL, claim)) {
+                    if (claim == NameMoved)
+                        return NULL;
+                    nameStoreByte(&tbl->ctrl[tbli], tag);
+                    if (nameAdd(&tbl->used, 1) + 1 >= tbl->avail - (tbl->avail >> 3))
+                        nametblGrow(tbl);
+                    return claim;
+                }
+                name = nameLoad(&tbl->slots[tbli]);
+            }
+            if (name == NameMoved)
+                return NULL;
+            if (nametblMatch(name))
+                return name;
+        }
+    }
+#undef nametblMatch
+
+    // Racing threads filled the table before it could grow
+    if (!nameLoad(&tbl->next))
+        nametblGrow(tbl);
+    return NULL;
+}
+
+// Intern a name (or migrate an interned one), starting from a table
+static Name *nametblIntern(NameTbl *tbl, size_t hash, char *strp, size_t strl, Name **newname) {
+    Name *name;
+    while (!(name = nametblProbe(tbl, hash, strp, strl, newname)))
+        tbl = nameLoad(&tbl->next);
+    return name;
+}
+
+// Migrate the next chunk of the oldest table's names to its next table.
+// Whoever finishes a table's migration retires it (but does not free it,
+// as other threads might still be probing it).
+static void nametblMigrate(NameTbl *tbl) {
+    NameTbl *next = nameLoad(&tbl->next);
+    size_t start = nameAdd(&tbl->migrate, NameMigrateChunk);
+    size_t end, tbli;
+    if (start >= tbl->avail)
+        return;
+    end = start + NameMigrateChunk < tbl->avail ? start + NameMigrateChunk : tbl->avail;
+    for (tbli = start; tbli < end; ++tbli) {
+        Name *name = nameLoad(&tbl->slots[tbli]);
+        if (name == NULL) {
+            if (nameCas(&tbl->slots[tbli], NULL, NameMoved))
+                continue;
+            name = nameLoad(&tbl->slots[tbli]);
+        }
+        if (name != NameMoved)
+            nametblIntern(next, name->hash, NULL, 0, &name);
+    }
+
+    // Retire fully migrated tables
+    if (nameAdd(&tbl->migrated, end - start) + (end - start) == tbl->avail) {
+        for (;;) {
+            NameTbl *oldest = nameLoad(&gNameTable);
+            if ((size_t)nameLoad(&oldest->migrated) != oldest->avail
+                || !nameCas(&gNameTable, oldest, oldest->next))
+                break;
+        }
+    }
+}
+
+// Return the index in keywordTbl of the reserved name matching a string, or -1 if none
+static int nametblKeyword(char *strp, size_t strl) {
+    int kw;
+    if (strl == 0 || strl > KeywordMaxLen)
+        return -1;
+    kw = keywordSlots[keywordHash(strp, strl, KeywordSeed) & (KeywordSlots - 1)] - 1;
+    return kw >= 0 && keywordTbl[kw].len == strl && memcmp(keywordTbl[kw].str, strp, strl) == 0 ? kw : -1;
+}
+
+// Get the interned Name matching a string that is not a reserved name
+static Name *nametblFindName(char *strp, size_t strl) {
+    NameTbl *tbl = nameLoad(&gNameTable);
+    Name *newname = NULL;
+    Name *name = nametblIntern(tbl, nameHash(strp, strl), strp, strl, &newname);
+
+    // Another thread added the same name first: drop ours
+    if (newname && newname != name)
+        memFreeBlk(newname, sizeof(Name) + strl);
+
+    // Help migrate names out of a full table
+    if (nameLoad(&tbl->next))
+        nametblMigrate(tbl);
+    return name;
 }
 
 /** Get pointer to interned Name in Global Name Table matching string. 
  * For unknown name, this allocates memory for the string and adds it to name table. */
 Name *nametblFind(char *strp, size_t strl) {
-    size_t hash;
-    Name **slotp;
-
-    // Hash provide string into table
-    nameHashFn(hash, strp, strl);
-    nametblFindSlot(slotp, hash, strp, strl);
-
-    // If not already a name, allocate memory for string and add to table
-    if (*slotp == NULL) {
-        Name *newname;
-        // Double table if it has gotten too full
-        if (++gNameTblUsed >= gNameTblCeil)
-            nametblGrow();
-
-        // Allocate and populate name info
-        *slotp = newname = memAllocBlk(sizeof(Name) + strl);
-        memcpy(&newname->namestr, strp, strl);
-        (&newname->namestr)[strl] = '\0';
-        newname->hash = hash;
-        newname->namesz = (unsigned char)strl;
-        newname->node = NULL;        // Node not yet known
+    int kw = nametblKeyword(strp, strl);
+    return kw >= 0 ? gKeywordNames[kw] : nametblFindName(strp, strl);
+}
+
+// Get the Name for an identifier the lexer scanned, along with its token type:
+// a keyword's own, PermToken for a permission, otherwise IdentToken
+Name *nametblFindToken(char *strp, size_t strl, uint16_t *toktype) {
+    int kw = nametblKeyword(strp, strl);
+    if (kw >= 0) {
+        *toktype = keywordTbl[kw].toktype;
+        return gKeywordNames[kw];
     }
-    return *slotp;
+    *toktype = IdentToken;
+    return nametblFindName(strp, strl);
 }
 
-// Return size of unused space for name table
+// Return the newest name table, once all names have migrated to it
+// (only when no thread is interning names)
+static NameTbl *nametblNewest() {
+    NameTbl *tbl;
+    while ((tbl = nameLoad(&gNameTable))->next)
+        nametblMigrate(tbl);
+    return tbl;
+}
+
+// Return number of names in the name table
+size_t nametblUsed() {
+    return gNameTable ? nameLoadSize(&nametblNewest()->used) : 0;
+}
+
+// Return size of unused space for name table (in its newest table, as it stands:
+// this may be called by a thread in the midst of migrating names)
 size_t nametblUnused() {
-    return (gNameTblAvail-gNameTblUsed)*sizeof(Name*);
+    NameTbl *tbl = nameLoad(&gNameTable);
+    NameTbl *next;
+    if (tbl == NULL)
+        return 0;
+    while ((next = nameLoad(&tbl->next)))
+        tbl = next;
+    return (tbl->avail - nameLoadSize(&tbl->used)) * (sizeof(Name *) + 1);
 }
 
 // Initialize name table
 void nametblInit() {
-    nametblGrow();
+    size_t avail = HashGroup;
+    size_t kw;
+    while (avail < gNameTblInitSize)
+        avail <<= 1;
+    gNameTable = nametblNew(avail);
+
+    // Intern the reserved names, which never go in the table
+    for (kw = 0; kw < sizeof(keywordTbl) / sizeof(Keyword); ++kw) {
+        char *strp = (char *)keywordTbl[kw].str;
+        gKeywordNames[kw] = nametblNewName(strp, keywordTbl[kw].len, nameHash(strp, keywordTbl[kw].len));
+    }
 }
 
 
@@ -168,9 +400,10 @@ void nametblInit() {
 // and will grow as needed.
 
 // An entry for preserving the node that was in global name table for the name
+// (as compact references, see memRef)
 typedef struct {
-    INamedNode *node;       // The previous node to restore on pop
-    Name *name;          // The name the node was indexed as
+    MemRef node;        // The previous node to restore on pop (INamedNode *)
+    MemRef name;        // The name the node was indexed as (Name *)
 } HookTableEntry;
 
 typedef struct {
@@ -203,6 +436,7 @@ void nametblHookPush() {
         gHookTables = (HookTable*)memAllocBlk(gHookTableSize * sizeof(HookTable));
         memset(gHookTables, 0, gHookTableSize * sizeof(HookTable));
         memcpy(gHookTables, oldtable, oldsize * sizeof(HookTable));
+        memFreeBlk(oldtable, oldsize * sizeof(HookTable));
     }
 
     HookTable *table = &gHookTables[gHookTablePos];
@@ -227,6 +461,7 @@ void nametblHookGrow() {
     tablemeta->hooktbl = (HookTableEntry *)memAllocBlk(tablemeta->alloc * sizeof(HookTableEntry));
     memset(tablemeta->hooktbl, 0, tablemeta->alloc * sizeof(HookTableEntry));
     memcpy(tablemeta->hooktbl, oldtable, oldsize * sizeof(HookTableEntry));
+    memFreeBlk(oldtable, oldsize * sizeof(HookTableEntry));
 }
 
 // Hook the named node in the current hooktable
@@ -235,8 +470,8 @@ void nametblHookNode(INamedNode *node) {
     if (tablemeta->size + 1 >= tablemeta->alloc)
         nametblHookGrow();
     HookTableEntry *entry = &tablemeta->hooktbl[tablemeta->size++];
-    entry->node = node->namesym->node; // Save previous node
-    entry->name = node->namesym;
+    entry->node = memRef(node->namesym->node); // Save previous node
+    entry->name = memRef(node->namesym);
     node->namesym->node = node; // Plug in new node
 }
 
@@ -246,8 +481,8 @@ void nametblHookAlias(Name *name, INamedNode *node) {
     if (tablemeta->size + 1 >= tablemeta->alloc)
         nametblHookGrow();
     HookTableEntry *entry = &tablemeta->hooktbl[tablemeta->size++];
-    entry->node = node->namesym->node; // Save previous node
-    entry->name = name;
+    entry->node = memRef(node->namesym->node); // Save previous node
+    entry->name = memRef(name);
     node->namesym->node = node; // Plug in new node
 }
 
@@ -257,7 +492,7 @@ void nametblHookPop() {
     HookTableEntry *entry = tablemeta->hooktbl;
     int cnt = tablemeta->size;
     while (cnt--) {
-        entry->name->node = entry->node;
+        ((Name *)memDeref(entry->name))->node = (INamedNode *)memDeref(entry->node);
         ++entry;
     }
     --gHookTablePos;
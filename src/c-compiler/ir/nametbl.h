@@ -14,23 +14,29 @@
 
 // The Global Name Table holds a context-spacific collection of names.
 // - Parse uses it to resolve:
-//   - reserved keywords
-//   - permission names that begin a declaration of a variable.
+//   - reserved keywords and permission names (via a perfect hash, see parser/keywords.h)
 //   - allocator names as part of a reference type
 // - Name resolution uses it (see "hook" functions) to resolve:
 //   - NameUse nodes to the name declaration node that they refer to
 
 // Global Name Table configuration variables
 size_t gNameTblInitSize;                  // Initial maximum number of unique names (must be power of 2)
-unsigned int gNameTblUtil;    // % utilization that triggers doubling of table
 
 // Allocate and initialize the global name table
 void nametblInit();
 
 // Get pointer to the Name struct for the name's string in the global name table 
 // For an unknown name, it allocates memory for the string and adds it to name table.
+// Several threads may call it at once.
 Name *nametblFind(char *strp, size_t strl);
 
+// Get the Name for an identifier the lexer scanned, along with its token type:
+// a keyword's own, PermToken for a permission, otherwise IdentToken
+Name *nametblFindToken(char *strp, size_t strl, uint16_t *toktype);
+
+// Return number of names in the global name table
+size_t nametblUsed();
+
 // Return how many bytes have been allocated for global name table but not yet used
 size_t nametblUnused();
 
@@ -21,6 +21,7 @@ FnDclNode *newFnDclNode(Name *namesym, uint16_t flags, INode *type, INode *val)
     name->value = val;
     name->llvmvar = NULL;
     name->nextnode = NULL;
+    name->srcend = 0;
     return name;
 }
 
@@ -84,19 +85,32 @@ void fnDclTypeCheck(PassState *pstate, FnDclNode *varnode) {
     pstate->fnsig = oldfnsig;
 }
 
+// Name a function's spans in the --time-trace timeline
+static char *fnDclTraceName(FnDclNode *fnnode) {
+    return fnnode->namesym ? &fnnode->namesym->namestr : "(anonymous)";
+}
+
 // Begin the processing of the data flow pass for this function
 void fnDclFlow(FnDclNode *fnnode) {
     if (errors)
         return;
+    int oldphase = statsPhase(StatsFlow);
+    traceBegin("flow", fnDclTraceName(fnnode));
     flowAliasInit();
     FlowState fstate;
     fstate.fnsig = (FnSigNode *)fnnode->vtype;
     fstate.scope = 1;
     blockFlow(&fstate, (BlockNode **)&fnnode->value);
+    traceEnd();
+    statsPhase(oldphase);
 }
 
 // Check the function declaration node
 void fnDclPass(PassState *pstate, FnDclNode *name) {
+    // Trace only functions with code (not the std library's intrinsics)
+    int traced = traceOn && name->value && name->value->tag == BlockTag;
+    if (traced)
+        traceBegin(pstate->pass == NameResolution ? "nameres" : "typecheck", fnDclTraceName(name));
     inodeWalk(pstate, &name->vtype);
     INode *vtype = iexpGetTypeDcl(name->vtype);
 
@@ -123,4 +137,6 @@ void fnDclPass(PassState *pstate, FnDclNode *name) {
             errorMsgNode((INode*)name, ErrorNoType, "Name must specify a type");
         break;
     }
+    if (traced)
+        traceEnd();
 }
@@ -13,6 +13,7 @@ typedef struct FnDclNode {
     INode *value;                // Block or intrinsic code nodes (NULL if no code)
     LLVMValueRef llvmvar;        // LLVM's handle for a declared variable (for generation)
     struct FnDclNode *nextnode;     // Link to next overloaded method with the same name (or NULL)
+    uint32_t srcend;            // Source location where the function's source text ends (0 if not parsed)
 } FnDclNode;
 
 FnDclNode *newFnDclNode(Name *namesym, uint16_t tag, INode *sig, INode *val);
@@ -59,7 +59,7 @@ void modPrint(ModuleNode *mod) {
     if (mod->namesym)
         inodeFprint("module %s\n", &mod->namesym->namestr);
     else
-        inodeFprint("IR for program %s\n", mod->lexer->url);
+        inodeFprint("IR for program %s\n", inodeSrcFile(mod)->url);
     inodePrintIncr();
     for (nodesFor(mod->nodes, cnt, nodesp)) {
         inodePrintIndent();
@@ -92,6 +92,9 @@ void modPass(PassState *pstate, ModuleNode *mod) {
     INode **nodesp;
     uint32_t cnt;
 
+    traceBegin(pstate->pass == NameResolution ? "nameres" : "typecheck",
+        mod->namesym ? &mod->namesym->namestr : inodeSrcFile(mod)->fname);
+
     // Switch name table over to new mod for name resolution
     if (pstate->pass == NameResolution)
         modHook((ModuleNode*)mod->owner, mod);
@@ -127,4 +130,5 @@ void modPass(PassState *pstate, ModuleNode *mod) {
         modHook(mod, (ModuleNode*)mod->owner);
 
     pstate->mod = svmod;
+    traceEnd();
 }
\ No newline at end of file
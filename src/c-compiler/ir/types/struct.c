@@ -30,14 +30,18 @@ void structPass(PassState *pstate, StructNode *node) {
     INode *svtypenode = pstate->typenode;
     pstate->typenode = (INode*)node;
     nametblHookPush();
-    INode **nodesp;
+    MemRef *nodesp;
     uint32_t cnt;
     for (imethnodesFor(&node->methprops, cnt, nodesp)) {
-        if (isNamedNode(*nodesp))
-            nametblHookNode((INamedNode*)*nodesp);
+        INode *prop = imethRefNode(*nodesp);
+        if (isNamedNode(prop))
+            nametblHookNode((INamedNode*)prop);
     }
     for (imethnodesFor(&node->methprops, cnt, nodesp)) {
-        inodeWalk(pstate, (INode**)nodesp);
+        // Walk a pointer copy, storing back any replacement node
+        INode *prop = imethRefNode(*nodesp);
+        inodeWalk(pstate, &prop);
+        *nodesp = memRef(prop);
     }
     nametblHookPop();
     pstate->typenode = svtypenode;
@@ -0,0 +1,158 @@
+/** Generate the perfect hash table of reserved names (run at build time)
+ * @file
+ *
+ * Usage: genkeywords <output header>
+ *
+ * Writes keywordtbl.h, for ir/nametbl.c: the reserved names, plus a table of slots
+ * indexed by keywordHash, where each reserved name has a slot of its own.
+ * The slot table is the smallest power of 2 (at least twice the number of names)
+ * for which a seed can be found that gives no two names the same slot.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "keywords.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A reserved name, and the token type (enum TokenTypes in lexer.h) the lexer gives it
+typedef struct GenKeyword {
+    char *str;
+    char *toktype;
+} GenKeyword;
+
+GenKeyword keywords[] = {
+    // Keywords
+    {"include", "IncludeToken"},
+    {"mod", "ModToken"},
+    {"extern", "ExternToken"},
+    {"set", "SetToken"},
+    {"fn", "FnToken"},
+    {"struct", "StructToken"},
+    {"alloc", "AllocToken"},
+    {"return", "RetToken"},
+    {"do", "DoToken"},
+    {"if", "IfToken"},
+    {"elif", "ElifToken"},
+    {"else", "ElseToken"},
+    {"while", "WhileToken"},
+    {"each", "EachToken"},
+    {"in", "InToken"},
+    {"by", "ByToken"},
+    {"break", "BreakToken"},
+    {"continue", "ContinueToken"},
+    {"not", "NotToken"},
+    {"or", "OrToken"},
+    {"and", "AndToken"},
+    {"as", "AsToken"},
+    {"into", "IntoToken"},
+    {"true", "trueToken"},
+    {"false", "falseToken"},
+    {"null", "nullToken"},
+
+    // Permissions
+    {"uni", "PermToken"},
+    {"mut", "PermToken"},
+    {"imm", "PermToken"},
+    {"const", "PermToken"},
+    {"mut1", "PermToken"},
+    {"opaq", "PermToken"},
+
+    // Allocators
+    {"own", "IdentToken"},
+    {"rc", "IdentToken"},
+
+    // Special names
+    {"_", "IdentToken"},
+    {"self", "IdentToken"},
+    {"this", "IdentToken"},
+
+    // Operator method names
+    {"+=", "IdentToken"}, {"-=", "IdentToken"}, {"*=", "IdentToken"}, {"/=", "IdentToken"},
+    {"%=", "IdentToken"}, {"|=", "IdentToken"}, {"&=", "IdentToken"}, {"^=", "IdentToken"},
+    {"<<=", "IdentToken"}, {">>=", "IdentToken"},
+    {"+", "IdentToken"}, {"-", "IdentToken"}, {"*", "IdentToken"}, {"/", "IdentToken"},
+    {"%", "IdentToken"}, {"|", "IdentToken"}, {"&", "IdentToken"}, {"^", "IdentToken"},
+    {"~", "IdentToken"}, {"<<", "IdentToken"}, {">>", "IdentToken"},
+    {"++", "IdentToken"}, {"--", "IdentToken"}, {"+++", "IdentToken"}, {"---", "IdentToken"},
+    {"==", "IdentToken"}, {"!=", "IdentToken"}, {"<=", "IdentToken"}, {"<", "IdentToken"},
+    {">=", "IdentToken"}, {">", "IdentToken"},
+    {"()", "IdentToken"}, {"[]", "IdentToken"}, {"&[]", "IdentToken"},
+};
+#define NbrKeywords (sizeof(keywords) / sizeof(GenKeyword))
+
+#define MaxTries 1000000    // Seeds to try for a slot table size, before doubling it
+
+unsigned char slots[1 << 16];    // Index+1 of the name in each slot, or 0 if empty
+
+// Try a seed: fill in the slots and return 1 if every name gets its own
+int genTrySeed(uint32_t seed, size_t nslots) {
+    size_t i;
+    memset(slots, 0, nslots);
+    for (i = 0; i < NbrKeywords; ++i) {
+        size_t slot = keywordHash(keywords[i].str, strlen(keywords[i].str), seed) & (nslots - 1);
+        if (slots[slot])
+            return 0;
+        slots[slot] = (unsigned char)(i + 1);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    FILE *out;
+    size_t nslots, i, maxlen = 0;
+    uint32_t seed = 0;
+    int found = 0;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: genkeywords <output header>\n");
+        return 1;
+    }
+
+    // Find a seed that gives every name its own slot, in as few slots as we can
+    for (nslots = 16; nslots < 2 * NbrKeywords; nslots <<= 1)
+        ;
+    for (; !found && nslots <= sizeof(slots); nslots <<= 1) {
+        uint32_t tries;
+        for (tries = 0; tries < MaxTries; ++tries) {
+            seed = 2166136261u + tries * 0x9e3779b9u;
+            if ((found = genTrySeed(seed, nslots)))
+                break;
+        }
+    }
+    if (!found) {
+        fprintf(stderr, "genkeywords: no perfect hash found\n");
+        return 1;
+    }
+    nslots >>= 1;
+
+    if (!(out = fopen(argv[1], "w"))) {
+        fprintf(stderr, "genkeywords: cannot write %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(out, "// Perfect hash table of reserved names (see parser/keywords.h)\n");
+    fprintf(out, "// Generated by parser/genkeywords.c: do not edit\n\n");
+    for (i = 0; i < NbrKeywords; ++i) {
+        if (strlen(keywords[i].str) > maxlen)
+            maxlen = strlen(keywords[i].str);
+    }
+    fprintf(out, "#define KeywordMaxLen %u\n", (unsigned)maxlen);
+    fprintf(out, "#define KeywordSeed 0x%08xu\n", (unsigned)seed);
+    fprintf(out, "#define KeywordSlots %u\n\n", (unsigned)nslots);
+
+    fprintf(out, "static const Keyword keywordTbl[%u] = {\n", (unsigned)NbrKeywords);
+    for (i = 0; i < NbrKeywords; ++i)
+        fprintf(out, "    {\"%s\", %u, %s},\n", keywords[i].str, (unsigned)strlen(keywords[i].str), keywords[i].toktype);
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "// Index+1 into keywordTbl of the name whose hash lands on the slot, or 0\n");
+    fprintf(out, "static const uint8_t keywordSlots[KeywordSlots] = {");
+    for (i = 0; i < nslots; ++i)
+        fprintf(out, "%s%u,", i % 16 ? " " : "\n    ", slots[i]);
+    fprintf(out, "\n};\n");
+
+    return fclose(out) == 0 ? 0 : 1;
+}
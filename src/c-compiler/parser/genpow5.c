@@ -0,0 +1,167 @@
+/** Generate the table of 128-bit powers of five (run at build time)
+ * @file
+ *
+ * Usage: genpow5 <output header>
+ *
+ * Writes pow5tbl.h, for parser/lexnum.c: for every power of ten a double can
+ * have (10^-342 through 10^308), the 128 most significant bits of 5^q, which
+ * the Eisel-Lemire algorithm multiplies a decimal literal's digits by.
+ * For negative q, this is the top 128 bits of 1/5^-q, rounded up where
+ * the algorithm needs it to be exact (q >= -27).
+ *
+ * The powers are computed exactly with simple arbitrary-precision arithmetic.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define Pow5Min (-342)
+#define Pow5Max 308
+
+// An unsigned integer of up to BigLimbs 32-bit limbs, least significant first
+#define BigLimbs 80
+typedef struct Big {
+    uint32_t limb[BigLimbs];
+} Big;
+
+// Number of significant bits
+int bigBits(Big *n) {
+    int i, bits;
+    for (i = BigLimbs - 1; i >= 0 && n->limb[i] == 0; --i)
+        ;
+    if (i < 0)
+        return 0;
+    for (bits = 32; !(n->limb[i] >> (bits - 1)); --bits)
+        ;
+    return i * 32 + bits;
+}
+
+int bigBit(Big *n, int bit) {
+    return (n->limb[bit >> 5] >> (bit & 31)) & 1;
+}
+
+void bigMulSmall(Big *n, uint32_t m) {
+    uint64_t carry = 0;
+    int i;
+    for (i = 0; i < BigLimbs; ++i) {
+        carry += (uint64_t)n->limb[i] * m;
+        n->limb[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+void bigAddSmall(Big *n, uint32_t a) {
+    int i;
+    for (i = 0; i < BigLimbs && a; ++i) {
+        n->limb[i] += a;
+        a = n->limb[i] < a;
+    }
+}
+
+// Shift left one bit, shifting in bit
+void bigShl1(Big *n, int bit) {
+    int i;
+    for (i = BigLimbs - 1; i > 0; --i)
+        n->limb[i] = (n->limb[i] << 1) | (n->limb[i - 1] >> 31);
+    n->limb[0] = (n->limb[0] << 1) | bit;
+}
+
+void bigShr(Big *n, int bits) {
+    Big r;
+    int i;
+    memset(&r, 0, sizeof(r));
+    for (i = 0; i < BigLimbs * 32 - bits; ++i)
+        r.limb[i >> 5] |= (uint32_t)bigBit(n, i + bits) << (i & 31);
+    *n = r;
+}
+
+int bigCmp(Big *a, Big *b) {
+    int i;
+    for (i = BigLimbs - 1; i >= 0; --i) {
+        if (a->limb[i] != b->limb[i])
+            return a->limb[i] < b->limb[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+void bigSub(Big *a, Big *b) {
+    uint64_t borrow = 0;
+    int i;
+    for (i = 0; i < BigLimbs; ++i) {
+        uint64_t diff = (uint64_t)a->limb[i] - b->limb[i] - borrow;
+        a->limb[i] = (uint32_t)diff;
+        borrow = (diff >> 32) & 1;
+    }
+}
+
+// Set quo to 2^exp / div, rounded down
+void bigPow2Div(Big *quo, int exp, Big *div) {
+    Big rem;
+    int bit;
+    memset(quo, 0, sizeof(*quo));
+    memset(&rem, 0, sizeof(rem));
+    for (bit = exp; bit >= 0; --bit) {
+        bigShl1(&rem, bit == exp);
+        bigShl1(quo, 0);
+        if (bigCmp(&rem, div) >= 0) {
+            bigSub(&rem, div);
+            quo->limb[0] |= 1;
+        }
+    }
+}
+
+// Keep only the 128 most significant bits (shifting left, if fewer)
+void bigTop128(Big *n) {
+    int bits = bigBits(n);
+    if (bits > 128)
+        bigShr(n, bits - 128);
+    while (bits++ < 128)
+        bigShl1(n, 0);
+}
+
+int main(int argc, char **argv) {
+    FILE *out;
+    int q;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: genpow5 <output header>\n");
+        return 1;
+    }
+    if (!(out = fopen(argv[1], "w"))) {
+        fprintf(stderr, "genpow5: cannot write %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(out, "// Top 128 bits of 5^q, for q from LexPow5Min to LexPow5Max (see parser/lexnum.c)\n");
+    fprintf(out, "// Generated by parser/genpow5.c: do not edit\n\n");
+    fprintf(out, "#define LexPow5Min (%d)\n", Pow5Min);
+    fprintf(out, "#define LexPow5Max %d\n\n", Pow5Max);
+    fprintf(out, "static const uint64_t lexPow5Tbl[%d][2] = {\n", Pow5Max - Pow5Min + 1);
+
+    for (q = Pow5Min; q <= Pow5Max; ++q) {
+        Big pow5, val;
+        int i, n = q < 0 ? -q : q;
+        memset(&pow5, 0, sizeof(pow5));
+        pow5.limb[0] = 1;
+        for (i = 0; i < n; ++i)
+            bigMulSmall(&pow5, 5);
+
+        if (q >= 0)
+            val = pow5;
+        else {
+            // 2^b / 5^n, with b large enough to give at least 128 bits of quotient
+            int bits = bigBits(&pow5);
+            bigPow2Div(&val, q >= -27 ? bits + 127 : 2 * bits + 128, &pow5);
+            bigAddSmall(&val, 1);
+        }
+        bigTop128(&val);
+        fprintf(out, "    {0x%08x%08xull, 0x%08x%08xull},\n",
+            val.limb[3], val.limb[2], val.limb[1], val.limb[0]);
+    }
+    fprintf(out, "};\n");
+
+    return fclose(out) == 0 ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+/** Reserved names: keywords, permissions, allocators and operators
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef keywords_h
+#define keywords_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The lexer and name table recognize reserved names with a perfect hash,
+// instead of probing the name table. At build time, genkeywords.c finds a seed
+// for which keywordHash gives every reserved name its own slot, and writes out
+// the table of reserved names and the slots that index it (keywordtbl.h).
+
+// A reserved name in the generated table
+typedef struct Keyword {
+    const char *str;
+    uint16_t len;
+    uint16_t toktype;    // The lexer's token type: keyword's own, PermToken or IdentToken
+} Keyword;
+
+// Hash a string of reserved name length (FNV-1a, with extra mixing of the high bits)
+static inline uint32_t keywordHash(const char *strp, size_t strl, uint32_t seed) {
+    uint32_t hash = seed;
+    while (strl--)
+        hash = (hash ^ (unsigned char)*strp++) * 16777619u;
+    return hash ^ (hash >> 15);
+}
+
+#endif
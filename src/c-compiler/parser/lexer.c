@@ -14,13 +14,19 @@
 #include "../shared/memory.h"
 #include "../shared/error.h"
 #include "../shared/utf8.h"
+#include "lexscan.h"
+#include "lexnum.h"
 #include "../shared/fileio.h"
+#include "../shared/cache.h"
+#include "../shared/stats.h"
+#include "../shared/trace.h"
 
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 
 // Global lexer state
-Lexer *lex = NULL;        // Current lexer
+LexThreadLocal Lexer *lex = NULL;        // Current lexer
 
 // Inject a new source stream into the lexer
 void lexInject(char *url, char *src) {
@@ -47,10 +53,10 @@ void lexInject(char *url, char *src) {
     lex->url = url;
     lex->fname = fileName(url);
     lex->source = src;
+    lex->srcbase = srclocAddFile(lex->url, lex->fname, src);
 
     // Initialize lexer context
-    lex->srcp = lex->tokp = lex->linep = src;
-    lex->linenbr = 1;
+    lex->srcp = lex->tokp = src;
     lex->flags = 0;
     lex->nbrcurly = 0;
     lex->nbrtoks = 0;
@@ -64,20 +70,39 @@ void lexInject(char *url, char *src) {
     lexNextToken();
 }
 
-// Inject a new source stream into the lexer
-void lexInjectFile(char *url) {
+// Load a source file, whose url is relative to cururl (if not NULL).
+// Return its source, and its full pathname in fn.
+char *lexLoadFile(char *cururl, char *url, char **fn) {
+    char *src = fileLoadSrc(cururl, url, fn);
+    if (!src)
+        errorMsg(ErrorNoFile, "Cannot find or read source file %s", url);
+    return src;
+}
+
+// Inject a new source stream into the lexer.
+// Return 0 (having logged an error) if the file cannot be loaded.
+int lexInjectFile(char *url) {
     char *src;
     char *fn;
+    int oldphase = statsPhase(StatsLex);
+    traceBegin("include", url);    // Ended by lexPop, once the file is parsed
     // Load specified source file
-    src = fileLoadSrc(lex? lex->url : NULL, url, &fn);
-    if (!src)
-        errorExit(ExitNF, "Cannot find or read source file %s", url);
+    src = lexLoadFile(lex? lex->url : NULL, url, &fn);
+    if (!src) {
+        traceEnd();
+        statsPhase(oldphase);
+        return 0;
+    }
+    cacheAddSource(fn, src);
 
     lexInject(fn, src);
+    statsPhase(oldphase);
+    return 1;
 }
 
 // Restore previous lexer's stream
 void lexPop() {
+    traceEnd();
     if (lex)
         lex = lex->prev;
 }
@@ -146,20 +171,23 @@ void lexScanChar(char *srcp) {
     lex->srcp = srcp;
 }
 
+// Skip over a string literal's body, to its closing quote (or end of source)
+static char *lexSkipStrBody(char *srcp) {
+    while (1) {
+        srcp = lexSkipUntil(srcp, '"', '\\', '"');
+        if (*srcp != '\\' || *(srcp + 1) == '\0')
+            return srcp;
+        srcp += 2;
+    }
+}
+
 void lexScanString(char *srcp) {
     uint64_t uchar;
     lex->tokp = srcp++;
 
-    // Conservatively count the size of the string
-    uint32_t srclen = 0;
-    while (*srcp && *srcp != '"') {
-        srclen++;
-        srcp++;
-        if (*srcp == '\\' && *(srcp + 1) == '"') {
-            srclen++;
-            srcp += 2;
-        }
-    }
+    // Conservatively size the string: no character or escape sequence
+    // takes more bytes in the string than in the source
+    uint32_t srclen = (uint32_t)(lexSkipStrBody(srcp) - srcp);
 
     // Build string literal
     char *newp = memAllocStr(NULL, srclen);
@@ -207,33 +235,51 @@ void lexScanString(char *srcp) {
 void lexScanNumber(char *srcp) {
 
     char *srcbeg;        // Pointer to the start of the token
-    uint64_t base;        // Radix for integer (10 or 16)
+    char *srcend;        // Pointer to the end of the number (before any type suffix)
+    uint64_t base;        // Radix for number (10 or 16)
     uint64_t intval;    // Calculated integer value for integer literal
-    char isFloat;        // nonzero when number token is a float, 'e' when in exponent
+    uint64_t mant;        // Significant digits of a floating point literal
+    int64_t exp;        // Its exponent (of 10, or of 2 for hex), for dropped or fraction digits
+    int ndigits;        // Number of significant digits in mant
+    int maxdigits;        // Most significant digits mant can hold
+    char truncated;        // nonzero when non-zero digits did not fit in mant
+    char overflow;        // nonzero when the integer value is too big for 64 bits
+    char isFloat;        // nonzero when number token is a float, 'e' when it has an exponent
 
     lex->tokp = srcbeg = srcp;
 
     // A leading zero may indicate a non-base 10 number
     base = 10;
+    maxdigits = LexDecDigits;
     if (*srcp=='0' && (*(srcp+1)=='x' || *(srcp+1)=='X')) {
         base = 16;
+        maxdigits = LexHexDigits;
         srcp += 2;
     }
 
-    // Validate and process remaining numeric digits
+    // Validate and process remaining numeric digits, in one pass for both
+    // the integer value and a float's significant digits
     isFloat = '\0';
-    intval = 0;
+    intval = mant = 0;
+    exp = 0;
+    ndigits = 0;
+    truncated = overflow = 0;
     while (1) {
-        // Only one exponent allowed
-        if (isFloat!='e' && (*srcp=='e' || *srcp=='E' || *srcp=='p' || *srcp=='P')) {
-            isFloat = 'e';
-            if (*++srcp == '-' || *srcp == '+')
-                srcp++;
+        uint64_t digit;
+
+        // Extract a number digit value from the character
+        if (*srcp>='0' && *srcp<='9')
+            digit = *srcp - '0';
+        else if (base==16 && *srcp>='A' && *srcp<='F')
+            digit = *srcp - 'A' + 10;
+        else if (base==16 && *srcp>='a' && *srcp<='f')
+            digit = *srcp - 'a' + 10;
+        else if (*srcp=='_') {
+            srcp++;
             continue;
         }
-        // Handle characters in a suspected integer
         // Decimal point means it is floating point after all
-        if (*srcp=='.') {
+        else if (*srcp=='.' && !isFloat) {
             // However, double periods is not floating point, but that subsequent token is range op
             if (*(srcp+1)=='.')
                 break;
@@ -241,22 +287,48 @@ void lexScanNumber(char *srcp) {
             isFloat = '.';
             continue;
         }
-        // Extract a number digit value from the character
-        if (*srcp>='0' && *srcp<='9')
-            intval = intval*base + *srcp++ - '0';
-        else if (*srcp=='_')
-            srcp++;
-        else if (base==16) {
-            if (*srcp>='A' && *srcp<='F')
-                intval = (intval<<4) + *srcp++ - 'A'+10;
-            else if (*srcp>='a' && *srcp<='f')
-                intval = (intval<<4) + *srcp++ - 'a'+10;
-            else
-                break;
-        }
         else
             break;
+        srcp++;
+
+        if (!isFloat) {
+            if (intval > (UINT64_MAX - digit) / base)
+                overflow = 1;
+            else
+                intval = intval*base + digit;
+        }
+        if (ndigits < maxdigits) {
+            mant = mant*base + digit;
+            if (mant)
+                ++ndigits;
+            if (isFloat)
+                exp -= base==10? 1 : 4;
+        }
+        else {
+            truncated |= digit != 0;
+            if (!isFloat)
+                exp += base==10? 1 : 4;
+        }
+    }
+
+    // Only one exponent allowed: 'e' for decimal, or 'p' (a power of 2) for hex
+    if (base==10? (*srcp=='e' || *srcp=='E') : (*srcp=='p' || *srcp=='P')) {
+        int64_t expval = 0;
+        char expneg = 0;
+        isFloat = 'e';
+        if (*++srcp == '-' || *srcp == '+')
+            expneg = *srcp++ == '-';
+        if (*srcp<'0' || *srcp>'9')
+            errorMsgLex(ErrorBadTok, "Number's exponent is missing its digits");
+        while ((*srcp>='0' && *srcp<='9') || *srcp=='_') {
+            // Any exponent this big under- or overflows, so stop counting
+            if (*srcp != '_' && expval < 100000)
+                expval = expval*10 + *srcp - '0';
+            srcp++;
+        }
+        exp += expneg? -expval : expval;
     }
+    srcend = srcp;
 
     // Process number's explicit type as part of the token
     if (*srcp=='d') {
@@ -304,10 +376,23 @@ void lexScanNumber(char *srcp) {
 
     // Set value and type
     if (isFloat) {
-        lex->val.floatlit = atof(srcbeg);
+        double val = base==10? lexDecFloat(mant, exp, truncated, srcbeg, srcend)
+            : lexHexFloat(mant, exp, truncated, srcbeg, srcend);
+        // An f32 overflows from halfway between its largest value and 2^128
+        if (isinf(val) || (lex->langtype == (INode*)f32Type && val >= 340282356779733661637539395458142568448.0))
+            errorMsgLex(ErrorBigLit, "Floating point literal is too big for its type");
+        lex->val.floatlit = val;
         lex->toktype = FloatLitToken;
     }
     else {
+        // Integers with a type suffix must fit (as a signed type's negation, at least)
+        unsigned char bits = ((NbrNode*)lex->langtype)->bits;
+        if (overflow)
+            errorMsgLex(ErrorBigLit, "Integer literal is too big for 64 bits");
+        else if (*srcend == 'i' && bits < 64 && intval > (1ull << (bits - 1)))
+            errorMsgLex(ErrorBigLit, "Integer literal is too big for its type");
+        else if (*srcend == 'u' && bits < 64 && intval >= (1ull << bits))
+            errorMsgLex(ErrorBigLit, "Integer literal is too big for its type");
         lex->val.uintlit = intval;
         lex->toktype = IntLitToken;
     }
@@ -319,44 +404,18 @@ void lexScanIdent(char *srcp) {
     char *srcbeg = srcp++;    // Pointer to the start of the token
     lex->tokp = srcbeg;
     while (1) {
-        switch (*srcp) {
-
         // Allow digit, letter or underscore in token
-        case '0': case '1': case '2': case '3': case '4':
-        case '5': case '6': case '7': case '8': case '9':
-        case 'a': case 'b': case 'c': case 'd': case 'e':
-        case 'f': case 'g': case 'h': case 'i': case 'j':
-        case 'k': case 'l': case 'm': case 'n': case 'o':
-        case 'p': case 'q': case 'r': case 's': case 't':
-        case 'u': case 'v': case 'w': case 'x': case 'y': case 'z':
-        case 'A': case 'B': case 'C': case 'D': case 'E':
-        case 'F': case 'G': case 'H': case 'I': case 'J':
-        case 'K': case 'L': case 'M': case 'N': case 'O':
-        case 'P': case 'Q': case 'R': case 'S': case 'T':
-        case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z':
-        case '_':
-            srcp++;
-            break;
+        srcp = lexSkipIdentChars(srcp);
 
-        default:
-            // Allow unicode letters in identifier name
-            if (utf8IsLetter(srcp))
-                srcp += utf8ByteSkip(srcp);
-            else {
-                INode *identNode;
-                // Find identifier token in name table and preserve info about it
-                // Substitute token type when identifier is a keyword
-                lex->val.ident = nametblFind(srcbeg, srcp-srcbeg);
-                identNode = (INode*)lex->val.ident->node;
-                if (identNode && identNode->tag == KeywordTag)
-                    lex->toktype = identNode->flags;
-                else if (identNode && identNode->tag == PermTag)
-                    lex->toktype = PermToken;
-                else
-                    lex->toktype = IdentToken;
-                lex->srcp = srcp;
-                return;
-            }
+        // Allow unicode letters in identifier name
+        if (utf8IsLetter(srcp))
+            srcp += utf8ByteSkip(srcp);
+        else {
+            // Find identifier token in name table and preserve info about it
+            // Substitute token type when identifier is a keyword or permission
+            lex->val.ident = nametblFindToken(srcbeg, srcp-srcbeg, &lex->toktype);
+            lex->srcp = srcp;
+            return;
         }
     }
 }
@@ -367,8 +426,7 @@ void lexScanTickedIdent(char *srcp) {
     lex->tokp = srcbeg;
 
     // Look for closing backtick, but not past end of line
-    while (*srcp != '`' && *srcp && *srcp != '\n' && *srcp != '\x1a')
-        srcp++;
+    srcp = lexSkipUntil(srcp, '`', '\n', '\x1a');
     if (*srcp != '`') {
         errorMsgLex(ErrorBadTok, "Back-ticked identifier requires closing backtick");
         srcp = srcbeg + 2;
@@ -383,32 +441,32 @@ void lexScanTickedIdent(char *srcp) {
 // Skip over nested block comment
 char *lexBlockComment(char *srcp) {
     int nest = 1;
-    while (*srcp) {
+    while (1) {
+        // Skip over comment text that cannot open or close anything
+        srcp = lexSkipUntil(srcp, '*', '/', '"');
+        if (*srcp == '\0')
+            return srcp;
         if (*srcp == '*' && *(srcp + 1) == '/') {
             if (--nest == 0)
                 return srcp+2;
-            ++srcp;
+            srcp += 2;
         }
         else if (*srcp == '/' && *(srcp + 1) == '*') {
             ++nest;
-            ++srcp;
-        }
-        // ignore tokens inside line comment
-        else if (*srcp == '/' && *(srcp + 1) == '/') {
             srcp += 2;
-            while (*srcp && *srcp++ != '\n');
         }
+        // ignore tokens inside line comment
+        else if (*srcp == '/' && *(srcp + 1) == '/')
+            srcp = lexSkipUntil(srcp + 2, '\n', '\n', '\n');
         // ignore tokens inside string literal
         else if (*srcp == '"') {
-            ++srcp;
-            while (*srcp && *srcp++ != '"') {
-                if (*(srcp - 1) == '\\' && *srcp == '"')
-                    srcp++;
-            }
+            srcp = lexSkipStrBody(srcp + 1);
+            if (*srcp == '"')
+                ++srcp;
         }
-        ++srcp;
+        else
+            ++srcp;
     }
-    return srcp;
 }
 
 // Shortcut macro for return a punctuation token
@@ -449,8 +507,23 @@ int lexInjectToken() {
     return 0;
 }
 
+static void lexScanToken();
+
 // Decode next token from the source into new lex->token
 void lexNextToken() {
+    // Time the lexer separately from the parser only when measuring
+    if (statsOn) {
+        int oldphase = statsPhase(StatsLex);
+        ++statsTokens;
+        lexScanToken();
+        statsPhase(oldphase);
+    }
+    else
+        lexScanToken();
+}
+
+// Scan the next token
+static void lexScanToken() {
     // Inject tokens, if needed based on current line's indentation
     if (lex->inject && lexInjectToken())
         return;
@@ -664,11 +737,8 @@ void lexNextToken() {
         // '/' or '//' or '/*'
         case '/':
             // Line comment: '//'
-            if (*(srcp+1)=='/') {
-                srcp += 2;
-                while (*srcp && *srcp!='\n' && *srcp!='\x1a')
-                    srcp++;
-            }
+            if (*(srcp+1)=='/')
+                srcp = lexSkipUntil(srcp + 2, '\n', '\x1a', '\n');
             // Block comment, nested: '/*'
             else if (*(srcp + 1) == '*') {
                 srcp = lexBlockComment(srcp+2);
@@ -683,7 +753,7 @@ void lexNextToken() {
 
         // Ignore white space
         case ' ': case '\t':
-            srcp++;
+            srcp = lexSkipWhile(srcp + 1, ' ', '\t');
             break;
 
         // Ignore carrier return
@@ -696,22 +766,16 @@ void lexNextToken() {
             ++srcp;
             if (lex->nbrcurly == 0) {
                 // Skip to end of line
-                while (*srcp && *srcp != '\n' && *srcp != '\x1a')
-                    srcp++;
+                srcp = lexSkipUntil(srcp, '\n', '\x1a', '\n');
                 // Skip over new line
-                if (*srcp == '\n') {
+                if (*srcp == '\n')
                     srcp++;
-                    lex->linep = srcp;
-                    lex->linenbr++;
-                }
             }
             break;
 
         // Handle new line
         case '\n':
             srcp++;
-            lex->linep = srcp;
-            lex->linenbr++;
             // In off-side mode
             if (lex->nbrcurly == 0) {
                 // Count line's indentation
@@ -722,12 +786,18 @@ void lexNextToken() {
                     else if (*srcp == ' ' || *srcp == '\t') {
                         if (lex->indentch == '\0')
                             lex->indentch = *srcp;
-                        if (*srcp != lex->indentch) {
+                        // Count a run of the usual indentation character at once
+                        if (*srcp == lex->indentch) {
+                            char *runp = lexSkipWhile(srcp, lex->indentch, lex->indentch);
+                            lex->curindent += (int16_t)(runp - srcp);
+                            srcp = runp;
+                        }
+                        else {
                             lex->tokp = lex->srcp = srcp;
                             errorMsgLex(WarnIndent, "Inconsistent line indentation character (tab vs. space)");
+                            srcp++;
+                            lex->curindent++;
                         }
-                        srcp++;
-                        lex->curindent++;
                     }
                     else
                         break;
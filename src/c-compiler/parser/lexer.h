@@ -30,6 +30,7 @@ typedef struct Lexer {
     char *url;        // The url where the source text came from
     char *fname;    // The filename of the url (no extension)
     char *source;    // The source text (0-terminated)
+    uint32_t srcbase;    // Source location of the source text (see shared/srcloc.h)
 
     struct Lexer *next;    // Next lexer (linked list of injected lexers)
     struct Lexer *prev; // Previous lexer
@@ -37,9 +38,7 @@ typedef struct Lexer {
     // Lexer's evolving state
     char *srcp;        // Current pointer
     char *tokp;        // Start of current token
-    char *linep;    // Pointer to start of current line
 
-    uint32_t linenbr;    // Current line number
     uint32_t flags;        // Lexer flags
     uint16_t toktype;    // TokenTypes
 
@@ -142,13 +141,22 @@ enum TokenTypes {
     NbrTokens
 };
 
-// Current lexer
-Lexer *lex;
+// Current lexer. Each thread parsing source files has its own.
+#ifdef _MSC_VER
+#define LexThreadLocal __declspec(thread)
+#else
+#define LexThreadLocal __thread
+#endif
+extern LexThreadLocal Lexer *lex;
 
 #define lexIsToken(tok) (lex->toktype == (tok))
 
+// Source location of the current token
+#define lexSrcLoc() (lex->srcbase + (uint32_t)(lex->tokp - lex->source))
+
 // Lexer functions
-void lexInjectFile(char *url);
+char *lexLoadFile(char *cururl, char *url, char **fn);
+int lexInjectFile(char *url);
 void lexInject(char *url, char *src);
 void lexPop();
 void lexNextToken();
@@ -0,0 +1,188 @@
+/** Lexer's conversion of number literals to floating point values
+ * @file
+ *
+ * A decimal literal is converted exactly, nearly always without big-number
+ * arithmetic. Small values use Clinger's fast path: digits and power of ten
+ * are both exact doubles, so one multiply or divide rounds correctly.
+ * Otherwise the Eisel-Lemire algorithm multiplies the digits by a 128-bit
+ * approximation of the power of ten (a generated table of powers of five)
+ * and rounds the top bits. With no more than 19 digits, this is proven exact.
+ * Longer literals try both bounds of their dropped digits; should those round
+ * apart, the C library's (correctly rounding) strtod settles it.
+ *
+ * Ref: Daniel Lemire, "Number Parsing at a Gigabyte per Second" (2021), and
+ * Noble Mushtak and Daniel Lemire, "Fast Number Parsing Without Fallback" (2023).
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "lexnum.h"
+#include "../shared/memory.h"
+#include "pow5tbl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Multiply two 64-bit values into a 128-bit product (lo in *a, hi in *b)
+static void lexMul128(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+// Number of leading zero bits in a non-zero value
+static int lexClz64(uint64_t val) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanReverse64(&i, val);
+    return 63 - (int)i;
+#elif defined(_MSC_VER)
+    int n = 0;
+    while (!(val & 0x8000000000000000ull)) {
+        val <<= 1;
+        ++n;
+    }
+    return n;
+#else
+    return __builtin_clzll(val);
+#endif
+}
+
+// Return a double from its bits
+static double lexBitsDouble(uint64_t bits) {
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+// Eisel-Lemire: return the bits of the double nearest to mant * 10^exp10
+static uint64_t lexEiselLemire(uint64_t mant, int64_t exp10) {
+    uint64_t lo, hi, bits;
+    int lz, upperbit, shift;
+    int64_t exp2;
+
+    if (mant == 0 || exp10 < LexPow5Min)
+        return 0;
+    if (exp10 > LexPow5Max)
+        return 0x7FF0000000000000ull;    // Infinity
+
+    // Normalize the digits, then multiply them by the power of five's top 64 bits.
+    // Only when the product's bits below the 55 kept might carry into them
+    // does the power's next 64 bits need to be multiplied in as well.
+    lz = lexClz64(mant);
+    mant <<= lz;
+    lo = mant;
+    hi = lexPow5Tbl[exp10 - LexPow5Min][0];
+    lexMul128(&lo, &hi);
+    if ((hi & 0x1FF) == 0x1FF) {
+        uint64_t lo2 = mant, hi2 = lexPow5Tbl[exp10 - LexPow5Min][1];
+        lexMul128(&lo2, &hi2);
+        lo += hi2;
+        if (hi2 > lo)
+            ++hi;
+    }
+
+    // Keep 54 bits (the mantissa, its implicit bit and a rounding bit).
+    // log2(10^q) = q + log2(5^q), and log2(5) ~ 217706 / 2^16.
+    upperbit = (int)(hi >> 63);
+    shift = upperbit + 9;
+    bits = hi >> shift;
+    exp2 = ((217706 * exp10) >> 16) + 63 + upperbit - lz + 1023;
+
+    // Subnormal
+    if (exp2 <= 0) {
+        if (-exp2 + 1 >= 64)
+            return 0;
+        bits >>= -exp2 + 1;
+        bits += bits & 1;
+        bits >>= 1;
+        // If rounding carried it up to the smallest normal, its exponent bit is now set
+        return bits;
+    }
+
+    // Round half to even: only possible when 5^q is exact in 64 bits
+    // and nothing but zeros were shifted out
+    if (lo <= 1 && exp10 >= -4 && exp10 <= 23 && (bits & 3) == 1
+        && (bits << shift) == hi)
+        bits &= ~1ull;
+    bits += bits & 1;
+    bits >>= 1;
+    if (bits >= (2ull << 52)) {
+        bits = 1ull << 52;
+        ++exp2;
+    }
+    if (exp2 >= 0x7FF)
+        return 0x7FF0000000000000ull;
+    return (bits & ~(1ull << 52)) | ((uint64_t)exp2 << 52);
+}
+
+// Convert a literal's text (without digit separators or type suffix) using the C library
+static double lexStrtod(char *srcp, char *srcend) {
+    MemMark mark = memScratchMark();
+    char *text = (char *)memScratchAlloc(srcend - srcp + 1);
+    char *textp = text;
+    double val;
+    while (srcp < srcend) {
+        if (*srcp != '_')
+            *textp++ = *srcp;
+        ++srcp;
+    }
+    *textp = '\0';
+    val = strtod(text, NULL);
+    memScratchRelease(mark);
+    return val;
+}
+
+// Return the double nearest to a decimal float literal's value
+double lexDecFloat(uint64_t mant, int64_t exp10, int truncated, char *srcp, char *srcend) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    uint64_t bits;
+
+    // Clinger's fast path
+    if (!truncated && mant <= (1ull << 53) && exp10 >= -22 && exp10 <= 22)
+        return exp10 < 0 ? (double)mant / pow10[-exp10] : (double)mant * pow10[exp10];
+
+    bits = lexEiselLemire(mant, exp10);
+    if (truncated && bits != lexEiselLemire(mant + 1, exp10))
+        return lexStrtod(srcp, srcend);
+    return lexBitsDouble(bits);
+}
+
+// Return the double nearest to a hexadecimal float literal's value
+double lexHexFloat(uint64_t mant, int64_t exp2, int truncated, char *srcp, char *srcend) {
+    int lz;
+    if (mant == 0)
+        return 0.0;
+
+    // With the top bit set, any dropped digits can stand in as the lowest bit.
+    // Converting to double then rounds correctly, and scaling is exact,
+    // unless the value is subnormal (rounded twice) or out of range.
+    lz = lexClz64(mant);
+    mant <<= lz;
+    exp2 -= lz;
+    if (truncated)
+        mant |= 1;
+    if (exp2 + 63 > 1023)
+        return HUGE_VAL;
+    if (exp2 + 63 < -1022)
+        return lexStrtod(srcp, srcend);
+    return ldexp((double)mant, (int)exp2);
+}
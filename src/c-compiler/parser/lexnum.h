@@ -0,0 +1,27 @@
+/** Lexer's conversion of number literals to floating point values
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef lexnum_h
+#define lexnum_h
+
+#include <stdint.h>
+
+// The lexer scans a float literal's digits into mant, at most LexDecDigits
+// decimal (or LexHexDigits hexadecimal) significant digits, and notes whether
+// any non-zero digits had to be dropped (truncated). The literal's value is
+// then mant * 10^exp (or * 2^exp). srcp through srcend is the literal's text,
+// which is used for the rare values that the fast conversion cannot settle.
+#define LexDecDigits 19
+#define LexHexDigits 16
+
+// Return the double nearest to a decimal float literal's value
+double lexDecFloat(uint64_t mant, int64_t exp10, int truncated, char *srcp, char *srcend);
+
+// Return the double nearest to a hexadecimal float literal's value
+double lexHexFloat(uint64_t mant, int64_t exp2, int truncated, char *srcp, char *srcend);
+
+#endif
@@ -0,0 +1,206 @@
+/** Lexer's fast scanning of character runs
+ * @file
+ *
+ * The short start of a run is scanned inline (see lexscan.h). These scanners finish
+ * off runs that go on longer. The vector scanners load whole aligned blocks of 16 or
+ * 32 bytes, compare every byte of a block at once, and use the lowest bit of the
+ * resulting mask of stopping bytes. As an aligned block never crosses a page
+ * boundary, a block holding the 0 terminator can be read safely even though it
+ * may extend past the end of the source, much like a C library's vectorized strlen.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "lexscan.h"
+
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LEXSCAN_SSE2
+#if defined(_MSC_VER) || defined(__GNUC__)
+#include <immintrin.h>
+#define LEXSCAN_AVX2
+#endif
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Block reads past the terminator are intended, so keep AddressSanitizer from
+// reporting them
+#if defined(__SANITIZE_ADDRESS__)
+#define LEXSCAN_NOASAN __attribute__((no_sanitize_address))
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define LEXSCAN_NOASAN __attribute__((no_sanitize_address))
+#endif
+#endif
+#ifndef LEXSCAN_NOASAN
+#define LEXSCAN_NOASAN
+#endif
+
+// Index of the lowest set bit of a non-zero mask
+#ifdef _MSC_VER
+static inline unsigned lexCtz(uint32_t bits) { unsigned long i; _BitScanForward(&i, bits); return i; }
+#else
+#define lexCtz(bits) ((unsigned)__builtin_ctz(bits))
+#endif
+
+#ifndef LEXSCAN_SSE2
+
+// Scalar scanners, for CPUs without vector support
+
+static char *lexSkipIdentScalar(char *srcp) {
+    while (lexIsIdentChar(*srcp))
+        ++srcp;
+    return srcp;
+}
+
+static char *lexSkipWhileScalar(char *srcp, char c1, char c2) {
+    while (*srcp == c1 || *srcp == c2)
+        ++srcp;
+    return srcp;
+}
+
+static char *lexSkipUntilScalar(char *srcp, char c1, char c2, char c3) {
+    while (*srcp && *srcp != c1 && *srcp != c2 && *srcp != c3)
+        ++srcp;
+    return srcp;
+}
+
+#endif
+
+// Scan aligned blocks (of type vec, width bytes wide) from the one holding srcp,
+// until stopmask (a function of the block's vector, giving a bit per byte that
+// ends the run) finds a stopping byte at or after srcp. Return a pointer to it.
+#define lexScanBlocks(vec, width, load, stopmask) { \
+    uintptr_t off = (uintptr_t)srcp & ((width) - 1); \
+    const vec *blkp = (const vec *)(srcp - off); \
+    vec blk = load(blkp); \
+    uint32_t bits = stopmask(blk) & (0xFFFFFFFFu << off); \
+    while (!bits) { \
+        blk = load(++blkp); \
+        bits = stopmask(blk); \
+    } \
+    return (char *)blkp + lexCtz(bits); \
+}
+
+#ifdef LEXSCAN_SSE2
+
+// Bytes that are identifier characters. Subtracting a range's first character
+// makes an unsigned range check one min and compare. OR-ing in 0x20 lower-cases
+// ASCII letters, without turning any other byte into one.
+static inline __m128i lexIdentSse2(__m128i blk) {
+    __m128i alpha = _mm_sub_epi8(_mm_or_si128(blk, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i digit = _mm_sub_epi8(blk, _mm_set1_epi8('0'));
+    alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(25)), alpha);
+    digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    return _mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(blk, _mm_set1_epi8('_')));
+}
+
+#define lexIdentStopSse2(blk) (~(uint32_t)_mm_movemask_epi8(lexIdentSse2(blk)) & 0xFFFF)
+
+LEXSCAN_NOASAN static char *lexSkipIdentSse2(char *srcp) {
+    lexScanBlocks(__m128i, 16, _mm_load_si128, lexIdentStopSse2);
+}
+
+LEXSCAN_NOASAN static char *lexSkipWhileSse2(char *srcp, char c1, char c2) {
+    __m128i v1 = _mm_set1_epi8(c1), v2 = _mm_set1_epi8(c2);
+#define lexWhileStopSse2(blk) (~(uint32_t)_mm_movemask_epi8( \
+        _mm_or_si128(_mm_cmpeq_epi8(blk, v1), _mm_cmpeq_epi8(blk, v2))) & 0xFFFF)
+    lexScanBlocks(__m128i, 16, _mm_load_si128, lexWhileStopSse2);
+}
+
+LEXSCAN_NOASAN static char *lexSkipUntilSse2(char *srcp, char c1, char c2, char c3) {
+    __m128i v1 = _mm_set1_epi8(c1), v2 = _mm_set1_epi8(c2), v3 = _mm_set1_epi8(c3);
+    __m128i zero = _mm_setzero_si128();
+#define lexUntilStopSse2(blk) ((uint32_t)_mm_movemask_epi8(_mm_or_si128( \
+        _mm_or_si128(_mm_cmpeq_epi8(blk, v1), _mm_cmpeq_epi8(blk, v2)), \
+        _mm_or_si128(_mm_cmpeq_epi8(blk, v3), _mm_cmpeq_epi8(blk, zero)))))
+    lexScanBlocks(__m128i, 16, _mm_load_si128, lexUntilStopSse2);
+}
+
+#endif
+
+#ifdef LEXSCAN_AVX2
+
+// AVX2 code is compiled for the functions that use it, not the whole compiler
+#ifdef _MSC_VER
+#define LEXSCAN_TARGET_AVX2
+#else
+#define LEXSCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+LEXSCAN_TARGET_AVX2 static inline __m256i lexIdentAvx2(__m256i blk) {
+    __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(blk, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i digit = _mm256_sub_epi8(blk, _mm256_set1_epi8('0'));
+    alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(25)), alpha);
+    digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    return _mm256_or_si256(_mm256_or_si256(alpha, digit), _mm256_cmpeq_epi8(blk, _mm256_set1_epi8('_')));
+}
+
+#define lexIdentStopAvx2(blk) (~(uint32_t)_mm256_movemask_epi8(lexIdentAvx2(blk)))
+
+LEXSCAN_NOASAN LEXSCAN_TARGET_AVX2 static char *lexSkipIdentAvx2(char *srcp) {
+    lexScanBlocks(__m256i, 32, _mm256_load_si256, lexIdentStopAvx2);
+}
+
+LEXSCAN_NOASAN LEXSCAN_TARGET_AVX2 static char *lexSkipWhileAvx2(char *srcp, char c1, char c2) {
+    __m256i v1 = _mm256_set1_epi8(c1), v2 = _mm256_set1_epi8(c2);
+#define lexWhileStopAvx2(blk) (~(uint32_t)_mm256_movemask_epi8( \
+        _mm256_or_si256(_mm256_cmpeq_epi8(blk, v1), _mm256_cmpeq_epi8(blk, v2))))
+    lexScanBlocks(__m256i, 32, _mm256_load_si256, lexWhileStopAvx2);
+}
+
+LEXSCAN_NOASAN LEXSCAN_TARGET_AVX2 static char *lexSkipUntilAvx2(char *srcp, char c1, char c2, char c3) {
+    __m256i v1 = _mm256_set1_epi8(c1), v2 = _mm256_set1_epi8(c2), v3 = _mm256_set1_epi8(c3);
+    __m256i zero = _mm256_setzero_si256();
+#define lexUntilStopAvx2(blk) ((uint32_t)_mm256_movemask_epi8(_mm256_or_si256( \
+        _mm256_or_si256(_mm256_cmpeq_epi8(blk, v1), _mm256_cmpeq_epi8(blk, v2)), \
+        _mm256_or_si256(_mm256_cmpeq_epi8(blk, v3), _mm256_cmpeq_epi8(blk, zero)))))
+    lexScanBlocks(__m256i, 32, _mm256_load_si256, lexUntilStopAvx2);
+}
+
+// Does the CPU (and the OS, which must save the wider registers) support AVX2?
+static int lexHasAvx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return 0;
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+        return 0;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+// The vector scanners, the SSE2 ones (or scalar) until lexScanInit picks something faster
+#if defined(LEXSCAN_SSE2)
+char *(*lexScanIdentChars)(char *srcp) = lexSkipIdentSse2;
+char *(*lexScanWhile)(char *srcp, char c1, char c2) = lexSkipWhileSse2;
+char *(*lexScanUntil)(char *srcp, char c1, char c2, char c3) = lexSkipUntilSse2;
+#else
+char *(*lexScanIdentChars)(char *srcp) = lexSkipIdentScalar;
+char *(*lexScanWhile)(char *srcp, char c1, char c2) = lexSkipWhileScalar;
+char *(*lexScanUntil)(char *srcp, char c1, char c2, char c3) = lexSkipUntilScalar;
+#endif
+
+// Choose the fastest vector scanners the CPU supports
+void lexScanInit() {
+#if defined(LEXSCAN_AVX2)
+    if (lexHasAvx2()) {
+        lexScanIdentChars = lexSkipIdentAvx2;
+        lexScanWhile = lexSkipWhileAvx2;
+        lexScanUntil = lexSkipUntilAvx2;
+    }
+#endif
+}
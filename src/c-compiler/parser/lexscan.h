@@ -0,0 +1,63 @@
+/** Lexer's fast scanning of character runs
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef lexscan_h
+#define lexscan_h
+
+// Each scanner returns a pointer to the first character at or after srcp that
+// ends the run it looks for. Scanners never stop past the source's 0 terminator.
+// Most runs (names, blanks between tokens) are short, so a scanner checks the
+// first LEXSCAN_SHORT characters one at a time, inline. Only a run longer than that
+// (a long comment, string or indentation) goes on to a vector scanner, which checks
+// 32 (AVX2), 16 (SSE2) or one character at a time, depending on the CPU.
+
+#define LEXSCAN_SHORT 16
+
+// Is c an ASCII identifier character (letter, digit or '_')?
+#define lexIsIdentChar(c) ((unsigned char)(((c) | 0x20) - 'a') < 26 \
+    || (unsigned char)((c) - '0') < 10 || (c) == '_')
+
+// The vector scanners, which finish off long runs
+extern char *(*lexScanIdentChars)(char *srcp);
+extern char *(*lexScanWhile)(char *srcp, char c1, char c2);
+extern char *(*lexScanUntil)(char *srcp, char c1, char c2, char c3);
+
+// Choose the fastest vector scanners the CPU supports.
+// Call once at startup, before any thread lexes.
+void lexScanInit();
+
+// Skip ASCII identifier characters (letters, digits and '_')
+static inline char *lexSkipIdentChars(char *srcp) {
+    char *endp = srcp + LEXSCAN_SHORT;
+    for (; srcp < endp; ++srcp) {
+        if (!lexIsIdentChar(*srcp))
+            return srcp;
+    }
+    return lexScanIdentChars(srcp);
+}
+
+// Skip characters that are either c1 or c2 (e.g., spaces and tabs)
+static inline char *lexSkipWhile(char *srcp, char c1, char c2) {
+    char *endp = srcp + LEXSCAN_SHORT;
+    for (; srcp < endp; ++srcp) {
+        if (*srcp != c1 && *srcp != c2)
+            return srcp;
+    }
+    return lexScanWhile(srcp, c1, c2);
+}
+
+// Skip to the first character that is c1, c2, c3 or the 0 terminator
+static inline char *lexSkipUntil(char *srcp, char c1, char c2, char c3) {
+    char *endp = srcp + LEXSCAN_SHORT;
+    for (; srcp < endp; ++srcp) {
+        if (*srcp == c1 || *srcp == c2 || *srcp == c3 || *srcp == '\0')
+            return srcp;
+    }
+    return lexScanUntil(srcp, c1, c2, c3);
+}
+
+#endif
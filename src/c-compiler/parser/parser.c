@@ -12,6 +12,10 @@
 #include "../shared/memory.h"
 #include "../shared/error.h"
 #include "../shared/fileio.h"
+#include "../shared/trace.h"
+#include "../shared/stats.h"
+#include "../shared/jobs.h"
+#include "../shared/cache.h"
 #include "../ir/nametbl.h"
 #include "../coneopts.h"
 #include "lexer.h"
@@ -100,6 +104,7 @@ INode *parseFn(ParseState *parse, uint16_t nodeflags, uint16_t mayflags) {
         if (!(mayflags&ParseMayImpl))
             errorMsgLex(ErrorBadImpl, "Function implementation is not allowed here.");
         fnnode->value = parseBlock(parse);
+        fnnode->srcend = lexSrcLoc();
     }
     else {
         if (!(mayflags&ParseMaySig))
@@ -131,15 +136,80 @@ char *parseFile() {
 
 void parseGlobalStmts(ParseState *parse, ModuleNode *mod);
 
-// Parse include statement
-void parseInclude(ParseState *parse) {
+// A source file parsed on a pool thread: a submodule's file, or an included file.
+// Its module comes first, so that a module flagged FlagParseFile is its ParseFile.
+typedef struct ParseFile {
+    ModuleNode mod;        // The submodule, or a stand-in collecting the included file's nodes
+    ParseState parse;    // Parse state to begin parsing the file with
+    char *cururl;        // url of the file that names it
+    char *filename;        // Its name, as given there
+    char *url;            // Its full pathname and source, once loaded
+    char *source;
+    ErrorLog errlog;    // Errors found while parsing it
+} ParseFile;
+
+// Create a module whose nodes will come from parsing a file on a pool thread
+static ModuleNode *parseNewFile(uint16_t flags) {
+    ModuleNode *mod = (ModuleNode *)memAllocBlk(sizeof(ParseFile));
+    statsCountNode(ModuleTag);
+    mod->tag = ModuleTag;
+    mod->flags = FlagParseFile | flags;
+    mod->srcloc = lexSrcLoc();
+    mod->namesym = NULL;
+    mod->owner = NULL;
+    mod->nodes = newNodes(64);
+    namespaceInit(&mod->namednodes, 64);
+    return mod;
+}
+
+// Hand a file to the pool to parse, starting from the current parse state
+static void parseFileQueue(ParseState *parse, ModuleNode *mod, char *filename) {
+    ParseFile *file = (ParseFile *)mod;
+    file->parse = *parse;
+    file->cururl = lex->url;
+    file->filename = filename;
+    jobsPoolAdd(parse->pool, file);
+}
+
+// Parse a file on a pool thread, logging its errors.
+// Its names are hooked later, by parseReplayModule.
+// A file that cannot be loaded logs an error and leaves its module empty, as in a serial parse.
+static void parseFileTask(void *item) {
+    ParseFile *file = (ParseFile *)item;
+    errorLogBegin(&file->errlog);
+    file->source = lexLoadFile(file->cururl, file->filename, &file->url);
+    if (file->source == NULL) {
+        errorLogEnd();
+        return;
+    }
+    lexInject(file->url, file->source);
+    if (file->mod.flags & FlagInclude) {
+        parseGlobalStmts(&file->parse, &file->mod);
+        if (lex->toktype != EofToken)
+            errorMsgLex(ErrorNoEof, "Expected end-of-file");
+    }
+    else
+        parseModuleBlk(&file->parse, &file->mod);
+    lexPop();
+    errorLogEnd();
+}
+
+// Parse include statement, adding the included file's nodes to mod
+void parseInclude(ParseState *parse, ModuleNode *mod) {
     char *filename;
     lexNextToken();
     filename = parseFile();
     parseSemi();
 
-    lexInjectFile(filename);
-    parseGlobalStmts(parse, parse->mod);
+    if (parse->pool) {
+        ModuleNode *incl = parseNewFile(FlagInclude);
+        nodesAdd(&mod->nodes, (INode*)incl);
+        parseFileQueue(parse, incl, filename);
+        return;
+    }
+    if (!lexInjectFile(filename))
+        return;
+    parseGlobalStmts(parse, mod);
     if (lex->toktype != EofToken) {
         errorMsgLex(ErrorNoEof, "Expected end-of-file");
     }
@@ -172,8 +242,16 @@ INode *parseFnOrVar(ParseState *parse, uint16_t flags) {
 
 ModuleNode *parseModule(ParseState *parse);
 
+// Add a parsed node to its module. modAddNode hooks its name, including error message for dupes.
+// When parsing in parallel, that waits for parseReplayModule.
+static void parseAddNode(ParseState *parse, ModuleNode *mod, INode *node) {
+    if (parse->pool)
+        nodesAdd(&mod->nodes, node);
+    else
+        modAddNode(mod, node);
+}
+
 // Parse a global area statement (within a module)
-// modAddNode adds node to module, as needed, including error message for dupes
 void parseGlobalStmts(ParseState *parse, ModuleNode *mod) {
     INode *node;
 
@@ -182,16 +260,16 @@ void parseGlobalStmts(ParseState *parse, ModuleNode *mod) {
         switch (lex->toktype) {
 
         case IncludeToken:
-            parseInclude(parse);
+            parseInclude(parse, mod);
             break;
 
         case ModToken:
-            modAddNode(mod, (INode*)parseModule(parse));
+            parseAddNode(parse, mod, (INode*)parseModule(parse));
             break;
 
         // 'struct'-style type definition
         case StructToken:
-            modAddNode(mod, parseStruct(parse));
+            parseAddNode(parse, mod, parseStruct(parse));
             break;
 
         // 'extern' qualifier in front of fn or var (block)
@@ -208,13 +286,13 @@ void parseGlobalStmts(ParseState *parse, ModuleNode *mod) {
                 lexNextToken();
                 while (lexIsToken(FnToken) || lexIsToken(PermToken)) {
                     if (node = parseFnOrVar(parse, extflag))
-                        modAddNode(mod, node);
+                        parseAddNode(parse, mod, node);
                 }
                 parseRCurly();
             }
             else
                 if (node = parseFnOrVar(parse, extflag))
-                    modAddNode(mod, node);
+                    parseAddNode(parse, mod, node);
         }
             break;
 
@@ -222,7 +300,7 @@ void parseGlobalStmts(ParseState *parse, ModuleNode *mod) {
         case FnToken:
         case PermToken:
             if (node = parseFnOrVar(parse, 0))
-                modAddNode(mod, node);
+                parseAddNode(parse, mod, node);
             break;
 
         default:
@@ -236,9 +314,11 @@ void parseGlobalStmts(ParseState *parse, ModuleNode *mod) {
 // Parse a module's global statement block
 ModuleNode *parseModuleBlk(ParseState *parse, ModuleNode *mod) {
     parse->mod = mod;
-    modHook((ModuleNode*)mod->owner, mod);
+    if (!parse->pool)
+        modHook((ModuleNode*)mod->owner, mod);
     parseGlobalStmts(parse, mod);
-    modHook(mod, (ModuleNode*)mod->owner);
+    if (!parse->pool)
+        modHook(mod, (ModuleNode*)mod->owner);
     parse->mod = (ModuleNode*)mod->owner;
     return mod;
 }
@@ -256,8 +336,8 @@ ModuleNode *parseModule(ParseState *parse) {
     if (!lexIsToken(LCurlyToken) && !lexIsToken(SemiToken))
         parseLCurly();
 
-    // This is a new module, build it
-    mod = newModuleNode();
+    // This is a new module, build it. When parsing in parallel, a file-based one is a ParseFile.
+    mod = lexIsToken(LCurlyToken) || !parse->pool ? newModuleNode() : parseNewFile(0);
     mod->owner = svowner;
     parse->owner = (INamedNode *)mod;
     mod->namesym = nametblFind(modname, strlen(modname));
@@ -268,25 +348,103 @@ ModuleNode *parseModule(ParseState *parse) {
     }
     else {
         parseSemi();
-        lexInjectFile(filename);
-        parseModuleBlk(parse, mod);
-        lexPop();
+        if (mod->flags & FlagParseFile)
+            parseFileQueue(parse, mod, filename);
+        else if (lexInjectFile(filename)) {
+            parseModuleBlk(parse, mod);
+            lexPop();
+        }
     }
     parse->owner = svowner;
     return mod;
 }
 
+static void parseReplayNodes(ModuleNode *mod, Nodes *parsed);
+
+// Do what loading a file parsed on a pool thread would have done in a serial parse:
+// add it to the cache's hash of the sources, and send out its errors
+static void parseReplayFile(ParseFile *file) {
+    if (file->source)
+        cacheAddSource(file->url, file->source);
+    errorLogReplay(&file->errlog);
+}
+
+// Once all files are parsed in parallel, do for a module what a serial parse would have
+// done along the way, in the same order: hook its names, as parseModuleBlk does,
+// and add its nodes, checking for duplicate names
+static void parseReplayModule(ModuleNode *mod) {
+    Nodes *parsed = mod->nodes;
+    mod->nodes = newNodes(64);
+    if (mod->flags & FlagParseFile)
+        parseReplayFile((ParseFile *)mod);
+    modHook((ModuleNode*)mod->owner, mod);
+    parseReplayNodes(mod, parsed);
+    modHook(mod, (ModuleNode*)mod->owner);
+}
+
+// Add parsed nodes to a module, with an included file's nodes in place of its stand-in
+static void parseReplayNodes(ModuleNode *mod, Nodes *parsed) {
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(parsed, cnt, nodesp)) {
+        if ((*nodesp)->flags & FlagInclude && (*nodesp)->tag == ModuleTag) {
+            parseReplayFile((ParseFile *)*nodesp);
+            parseReplayNodes(mod, ((ModuleNode *)*nodesp)->nodes);
+            continue;
+        }
+        if ((*nodesp)->tag == ModuleTag)
+            parseReplayModule((ModuleNode *)*nodesp);
+        modAddNode(mod, *nodesp);
+    }
+}
+
 // Parse a program = the main module
-ModuleNode *parsePgm(ConeOptions *opt) {
-    // Initialize name table and populate with std library names
+// Pointer size the name table's pristine std library names were built for (0 if none)
+static int parseStdPtrsize = 0;
+
+// Initialize name table and populate with std library names.
+// A compile server does this once, so that every compile it forks starts warm.
+void parseStd(int ptrsize) {
+    if (parseStdPtrsize == ptrsize)
+        return;
     nametblInit();
-    stdlibInit(opt->ptrsize);
-    lexInjectFile(opt->srcpath);
+    stdlibInit(ptrsize);
+    parseStdPtrsize = ptrsize;
+}
+
+ModuleNode *parsePgm(ConeOptions *opt) {
+    // Start from the std library names (unless already warm).
+    // This program's names will then leave the name table no longer pristine.
+    parseStd(opt->ptrsize);
+    parseStdPtrsize = 0;
+    statsPhase(StatsParse);
+    if (!lexInjectFile(opt->srcpath))
+        errorExit(ExitNF, "Unsuccessful compile: program source file not found");
 
     ParseState parse;
     ModuleNode *mod;
+    ErrorLog errlog;
     mod = newModuleNode();
     parse.pgmmod = mod;
     parse.owner = (INamedNode *)mod;
-    return parseModuleBlk(&parse, mod);
+    parse.pool = NULL;
+
+    // With parallel jobs, submodule and included files are parsed on a pool of threads.
+    // Not when measuring, though: stats and traces assume it all happens on one thread.
+    if (opt->jobs > 1 && !statsOn && !traceOn) {
+        parse.pool = jobsPoolStart(opt->jobs - 1, parseFileTask);
+        errorLogBegin(&errlog);
+    }
+    parseModuleBlk(&parse, mod);
+    if (parse.pool) {
+        errorLogEnd();
+        jobsPoolFinish(parse.pool);
+        errorLogReplay(&errlog);
+        parseReplayModule(mod);
+    }
+
+    // The main source file is never popped (later passes still make nodes from its lexer),
+    // so end its trace span here
+    traceEnd();
+    return mod;
 }
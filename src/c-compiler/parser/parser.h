@@ -10,11 +10,13 @@
 
 #include "../ir/ir.h"
 typedef struct ConeOptions ConeOptions;
+typedef struct JobsPool JobsPool;
 
 typedef struct ParseState {
     ModuleNode *pgmmod;    // Root module for program
     ModuleNode *mod;        // Current module
     INamedNode *owner;    // Current namespace owning named nodes
+    JobsPool *pool;        // Threads parsing submodule and included files (NULL if parsing serially)
 } ParseState;
 
 // When parsing a variable definition, what syntax is allowed?
@@ -27,6 +29,7 @@ enum ParseFlags {
 };
 
 // parser.c
+void parseStd(int ptrsize);
 ModuleNode *parsePgm(ConeOptions *opt);
 ModuleNode *parseModuleBlk(ParseState *parse, ModuleNode *mod);
 INode *parseFn(ParseState *parse, uint16_t nodeflags, uint16_t mayflags);
@@ -0,0 +1,240 @@
+/** Content-addressed cache of compiled outputs
+ * @file
+ *
+ * Every compile folds its inputs (compiler build, relevant options, and the
+ * name and contents of every loaded source file) into a 128-bit digest.
+ * The compiled output is kept in the cache folder under that hash's hex digits,
+ * so an identical compile can reuse it rather than regenerate it.
+ *
+ * Several compiler processes may share a cache folder. Entries are written
+ * to a process-unique temporary file and renamed into place, so readers only
+ * ever see complete entries. Once the folder exceeds its size limit,
+ * the least recently used entries (by modification time) are evicted.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "cache.h"
+#include "digest.h"
+#include "fileio.h"
+#include "memory.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#include <sys/utime.h>
+#define getpid _getpid
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+static char *cacheDir = NULL;
+static size_t cacheMaxSize;
+static Digest cacheDigest;
+
+// Create folder (and any missing parent folders)
+static void cacheMakeDir(char *dir) {
+    char *path = memAllocStr(dir, strlen(dir));
+    char *p;
+    for (p = path + 1; *p; ++p) {
+        if (*p == '/' || *p == '\\') {
+            char sv = *p;
+            *p = '\0';
+#ifdef _WIN32
+            _mkdir(path);
+#else
+            mkdir(path, 0777);
+#endif
+            *p = sv;
+        }
+    }
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0777);
+#endif
+}
+
+// Turn on the cache, stored in the specified folder (created if needed)
+int cacheInit(char *dir, size_t maxsize) {
+    struct stat st;
+    cacheMakeDir(dir);
+    if (stat(dir, &st) != 0 || !(st.st_mode & S_IFDIR))
+        return 0;
+    cacheDir = dir;
+    cacheMaxSize = maxsize;
+    digestInit(&cacheDigest);
+    return 1;
+}
+
+// Is the cache turned on?
+int cacheActive() {
+    return cacheDir != NULL;
+}
+
+// Add bytes to the hash of everything this compile depends on
+void cacheHashBytes(void *data, size_t size) {
+    digestBytes(&cacheDigest, data, size);
+}
+
+// Add a string to the hash, distinct from its neighbors
+void cacheHashStr(char *str) {
+    digestStr(&cacheDigest, str);
+}
+
+// Add a loaded source file (its name and contents) to the hash
+void cacheAddSource(char *fn, char *src) {
+    if (!cacheActive())
+        return;
+    cacheHashStr(fn);
+    cacheHashStr(src);
+}
+
+// Build the path of the cache entry for the current hash
+static char *cacheEntryPath(char *ext) {
+    char name[33];
+    digestHex(&cacheDigest, name);
+    return fileMakePath(cacheDir, name, ext);
+}
+
+// Look up the output whose inputs match the hash so far
+char *cacheLookup(char *ext, size_t *size) {
+    char *path = cacheEntryPath(ext);
+    char *buf;
+    struct stat st;
+
+    if (stat(path, &st) != 0 || !(buf = fileLoad(path)))
+        return NULL;
+    *size = st.st_size;
+
+    // Touch the entry, so eviction treats it as recently used
+    utime(path, NULL);
+    return buf;
+}
+
+// Information about one cache entry, for eviction
+typedef struct CacheEntry {
+    char *path;
+    size_t size;
+    time_t mtime;
+} CacheEntry;
+
+// Order cache entries from least to most recently used
+static int cacheEntryCmp(const void *a, const void *b) {
+    time_t ta = ((CacheEntry *)a)->mtime;
+    time_t tb = ((CacheEntry *)b)->mtime;
+    return ta < tb ? -1 : ta > tb;
+}
+
+// Collect all entries in the cache folder, returning their count
+static size_t cacheEntries(CacheEntry **entries, size_t *total) {
+    size_t cnt = 0;
+    size_t avail = 256;
+    struct stat st;
+#ifdef _WIN32
+    WIN32_FIND_DATA fd;
+    HANDLE dir = FindFirstFile(fileMakePath(cacheDir, "*", "*"), &fd);
+    if (dir == INVALID_HANDLE_VALUE)
+        return 0;
+#else
+    struct dirent *fd;
+    DIR *dir = opendir(cacheDir);
+    if (dir == NULL)
+        return 0;
+#endif
+
+    *entries = (CacheEntry *)malloc(avail * sizeof(CacheEntry));
+    *total = 0;
+#ifdef _WIN32
+    do {
+        char *fn = fd.cFileName;
+#else
+    while ((fd = readdir(dir))) {
+        char *fn = fd->d_name;
+#endif
+        char *path;
+        if (fn[0] == '.')
+            continue;
+        path = memAllocStr(cacheDir, strlen(cacheDir) + strlen(fn) + 1);
+        strcat(path, "/");
+        strcat(path, fn);
+        if (stat(path, &st) != 0 || !(st.st_mode & S_IFREG))
+            continue;
+        if (cnt == avail) {
+            avail <<= 1;
+            *entries = (CacheEntry *)realloc(*entries, avail * sizeof(CacheEntry));
+        }
+        (*entries)[cnt].path = path;
+        (*entries)[cnt].size = st.st_size;
+        (*entries)[cnt].mtime = st.st_mtime;
+        *total += st.st_size;
+        ++cnt;
+#ifdef _WIN32
+    } while (FindNextFile(dir, &fd));
+    FindClose(dir);
+#else
+    }
+    closedir(dir);
+#endif
+    return cnt;
+}
+
+// Evict least recently used entries until the cache is safely below its size limit.
+// Another process may already have removed an entry: that is fine.
+static void cacheEvict() {
+    CacheEntry *entries;
+    size_t total, cnt, i;
+
+    if ((cnt = cacheEntries(&entries, &total)) == 0)
+        return;
+    if (total > cacheMaxSize) {
+        qsort(entries, cnt, sizeof(CacheEntry), cacheEntryCmp);
+        for (i = 0; i < cnt && total > cacheMaxSize - cacheMaxSize / 4; ++i) {
+            remove(entries[i].path);
+            total -= entries[i].size;
+        }
+    }
+    free(entries);
+}
+
+// Store the output for the hash so far, then evict oldest entries beyond the size limit
+void cacheStore(char *ext, char *buf, size_t size) {
+    char *path = cacheEntryPath(ext);
+    char tmpext[64];
+    char *tmppath;
+
+    // Write privately, then rename into place so readers never see a partial entry
+    sprintf(tmpext, "%s.%d.tmp", ext, (int)getpid());
+    tmppath = cacheEntryPath(tmpext);
+    if (!fileWrite(tmppath, buf, size)) {
+        remove(tmppath);
+        return;
+    }
+#ifdef _WIN32
+    if (!MoveFileEx(tmppath, path, MOVEFILE_REPLACE_EXISTING))
+        remove(tmppath);
+#else
+    if (rename(tmppath, path) != 0)
+        remove(tmppath);
+#endif
+
+    cacheEvict();
+}
+
+// Store the contents of an output file for the hash so far
+void cacheStoreFile(char *ext, char *path) {
+    struct stat st;
+    char *buf;
+    if (stat(path, &st) == 0 && (buf = fileLoad(path)))
+        cacheStore(ext, buf, st.st_size);
+}
@@ -0,0 +1,40 @@
+/** Content-addressed cache of compiled outputs
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef cache_h
+#define cache_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Turn on the cache, stored in the specified folder (created if needed)
+// and kept to no more than maxsize bytes. Returns 0 if the folder is not usable.
+int cacheInit(char *dir, size_t maxsize);
+
+// Add bytes (e.g., an option value) to the hash of everything this compile depends on
+void cacheHashBytes(void *data, size_t size);
+
+// Add a string (e.g., an option value) to the hash, distinct from its neighbors
+void cacheHashStr(char *str);
+
+// Add a loaded source file (its name and contents) to the hash. No-op if the cache is off.
+void cacheAddSource(char *fn, char *src);
+
+// Look up the output whose inputs match the hash so far.
+// On a hit, returns the cached bytes (and sets size). Returns NULL on a miss.
+char *cacheLookup(char *ext, size_t *size);
+
+// Store the output for the hash so far, then evict oldest entries beyond the size limit
+void cacheStore(char *ext, char *buf, size_t size);
+
+// Store the contents of an output file for the hash so far
+void cacheStoreFile(char *ext, char *path);
+
+// Is the cache turned on?
+int cacheActive();
+
+#endif
@@ -0,0 +1,137 @@
+/** 128-bit content digests
+ * @file
+ *
+ * A digest is SHA-256 (FIPS 180-4), truncated to its first 128 bits.
+ * The cache and incremental builds trust a matching digest to mean matching
+ * inputs, so it takes a vetted cryptographic hash, rather than a fast one
+ * whose collisions nobody has looked for. The inputs hashed (options and
+ * source text) are small enough that its speed does not matter.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "digest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// SHA-256's round constants
+static const uint32_t digestK[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// Rotate 32-bit value right
+#define digestRotr(x, r) (((x) >> (r)) | ((x) << (32 - (r))))
+
+// Fold one 64-byte block into the digest's state
+static void digestBlock(Digest *digest, const unsigned char *blk) {
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h;
+    int i;
+
+    for (i = 0; i < 16; ++i)
+        w[i] = (uint32_t)blk[i * 4] << 24 | (uint32_t)blk[i * 4 + 1] << 16
+            | (uint32_t)blk[i * 4 + 2] << 8 | blk[i * 4 + 3];
+    for (i = 16; i < 64; ++i) {
+        uint32_t s0 = digestRotr(w[i - 15], 7) ^ digestRotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = digestRotr(w[i - 2], 17) ^ digestRotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = digest->state[0]; b = digest->state[1]; c = digest->state[2]; d = digest->state[3];
+    e = digest->state[4]; f = digest->state[5]; g = digest->state[6]; h = digest->state[7];
+    for (i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (digestRotr(e, 6) ^ digestRotr(e, 11) ^ digestRotr(e, 25))
+            + ((e & f) ^ (~e & g)) + digestK[i] + w[i];
+        uint32_t t2 = (digestRotr(a, 2) ^ digestRotr(a, 13) ^ digestRotr(a, 22))
+            + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    digest->state[0] += a; digest->state[1] += b; digest->state[2] += c; digest->state[3] += d;
+    digest->state[4] += e; digest->state[5] += f; digest->state[6] += g; digest->state[7] += h;
+}
+
+// Start a new, empty digest
+void digestInit(Digest *digest) {
+    static const uint32_t init[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(digest->state, init, sizeof(init));
+    digest->len = 0;
+}
+
+// Add bytes to the digest
+void digestBytes(Digest *digest, void *data, size_t size) {
+    unsigned char *p = (unsigned char *)data;
+    size_t used = (size_t)(digest->len & 63);
+    digest->len += size;
+
+    // Top up a partly filled block first
+    if (used) {
+        size_t fill = 64 - used < size ? 64 - used : size;
+        memcpy(digest->buf + used, p, fill);
+        p += fill;
+        size -= fill;
+        if (used + fill < 64)
+            return;
+        digestBlock(digest, digest->buf);
+    }
+    while (size >= 64) {
+        digestBlock(digest, p);
+        p += 64;
+        size -= 64;
+    }
+    memcpy(digest->buf, p, size);
+}
+
+// Add a file's contents to the digest, a chunk at a time. Returns 0 if it can't be read.
+int digestFile(Digest *digest, char *fn) {
+    unsigned char chunk[16384];
+    size_t cnt;
+    FILE *file = fopen(fn, "rb");
+    if (file == NULL)
+        return 0;
+    while ((cnt = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        digestBytes(digest, chunk, cnt);
+    fclose(file);
+    return 1;
+}
+
+// Add a string to the digest, length-prefixed so that neighboring strings can't run together
+void digestStr(Digest *digest, char *str) {
+    uint64_t len;
+    if (str == NULL)
+        str = "";
+    len = strlen(str);
+    digestBytes(digest, &len, sizeof(len));
+    digestBytes(digest, str, len);
+}
+
+// Finish the digest, writing it as 32 hex digits plus '\0'.
+// The padding goes into a copy, so the digest may still be added to.
+void digestHex(Digest *digest, char *hex) {
+    Digest fin = *digest;
+    unsigned char pad[72];
+    size_t padlen = 64 + 56 - (size_t)(digest->len & 63);
+    uint64_t bits = digest->len << 3;
+    int i;
+
+    if (padlen > 64)
+        padlen -= 64;
+    memset(pad, 0, sizeof(pad));
+    pad[0] = 0x80;
+    for (i = 0; i < 8; ++i)
+        pad[padlen + i] = (unsigned char)(bits >> (56 - i * 8));
+    digestBytes(&fin, pad, padlen + 8);
+    for (i = 0; i < 4; ++i)
+        sprintf(hex + i * 8, "%08lx", (unsigned long)fin.state[i]);
+}
@@ -0,0 +1,36 @@
+/** 128-bit content digests
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef digest_h
+#define digest_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Running state of a digest (SHA-256, truncated to 128 bits)
+typedef struct Digest {
+    uint32_t state[8];
+    uint64_t len;               // Number of bytes added
+    unsigned char buf[64];      // Bytes added since the last full block
+} Digest;
+
+// Start a new, empty digest
+void digestInit(Digest *digest);
+
+// Add bytes to the digest
+void digestBytes(Digest *digest, void *data, size_t size);
+
+// Add a file's contents to the digest. Returns 0 if it can't be read.
+int digestFile(Digest *digest, char *fn);
+
+// Add a string to the digest, length-prefixed so that neighboring strings can't run together
+void digestStr(Digest *digest, char *str);
+
+// Finish the digest (which may still be added to), writing it as 32 hex digits plus '\0'
+void digestHex(Digest *digest, char *hex);
+
+#endif
@@ -8,15 +8,33 @@
 #include "error.h"
 #include "../parser/lexer.h"
 #include "../ir/ir.h"
+#include "memory.h"
+#include "stats.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 #include <time.h>
 
 int errors = 0;
 int warnings = 0;
-clock_t startTime;
+double startTime;
+
+// A logged error or warning: its code, formatted message, and source location (if any)
+struct ErrorLogMsg {
+    int code;
+    int hasloc;
+    uint32_t srcloc;
+    char *text;
+};
+
+#ifdef _MSC_VER
+#define ErrorThreadLocal __declspec(thread)
+#else
+#define ErrorThreadLocal __thread
+#endif
+static ErrorThreadLocal ErrorLog *errorLog = NULL;    // This thread's log, if logging
 
 // Send an error message to stderr
 void errorExit(int exitcode, const char *msg, ...) {
@@ -76,11 +94,49 @@ void errorOutCode(char *tokp, uint32_t linenbr, char *linep, char *url, int code
     fprintf(stderr, "^--- %s:%d:%d\n", url, linenbr, pos);
 }
 
+// Log an error message for later, formatting it now
+static void errorLogAdd(int hasloc, uint32_t srcloc, int code, const char *msg, va_list args) {
+    ErrorLogMsg *logmsg;
+    va_list argscopy;
+    int size;
+
+    if (errorLog->used == errorLog->avail) {
+        ErrorLogMsg *oldmsgs = errorLog->msgs;
+        errorLog->avail = errorLog->avail == 0 ? 16 : errorLog->avail << 1;
+        errorLog->msgs = (ErrorLogMsg *)memAllocBlk(errorLog->avail * sizeof(ErrorLogMsg));
+        if (oldmsgs) {
+            memcpy(errorLog->msgs, oldmsgs, errorLog->used * sizeof(ErrorLogMsg));
+            memFreeBlk(oldmsgs, errorLog->used * sizeof(ErrorLogMsg));
+        }
+    }
+    logmsg = &errorLog->msgs[errorLog->used++];
+    logmsg->code = code;
+    logmsg->hasloc = hasloc;
+    logmsg->srcloc = srcloc;
+    va_copy(argscopy, args);
+    size = vsnprintf(NULL, 0, msg, argscopy);
+    va_end(argscopy);
+    logmsg->text = memAllocStr(NULL, size);
+    vsnprintf(logmsg->text, size + 1, msg, args);
+}
+
+// Send an error message plus code context for a source location to stderr
+static void errorOutLoc(uint32_t srcloc, int code, const char *msg, va_list args) {
+    char *linep;
+    uint32_t linenbr;
+    if (errorLog) {
+        errorLogAdd(1, srcloc, code, msg, args);
+        return;
+    }
+    linenbr = srclocLine(srcloc, &linep);
+    errorOutCode(srclocPtr(srcloc), linenbr, linep, srclocFile(srcloc)->url, code, msg, args);
+}
+
 // Send an error message to stderr
 void errorMsgNode(INode *node, int code, const char *msg, ...) {
     va_list argptr;
     va_start(argptr, msg);
-    errorOutCode(node->srcp, node->linenbr, node->linep, node->lexer->url, code, msg, argptr);
+    errorOutLoc(node->srcloc, code, msg, argptr);
     va_end(argptr);
 }
 
@@ -88,7 +144,7 @@ void errorMsgNode(INode *node, int code, const char *msg, ...) {
 void errorMsgLex(int code, const char *msg, ...) {
     va_list argptr;
     va_start(argptr, msg);
-    errorOutCode(lex->tokp, lex->linenbr, lex->linep, lex->url, code, msg, argptr);
+    errorOutLoc(lexSrcLoc(), code, msg, argptr);
     va_end(argptr);
 }
 
@@ -96,15 +152,50 @@ void errorMsgLex(int code, const char *msg, ...) {
 void errorMsg(int code, const char *msg, ...) {
     va_list argptr;
     va_start(argptr, msg);
-    errorOut(code, msg, argptr);
+    if (errorLog)
+        errorLogAdd(0, 0, code, msg, argptr);
+    else
+        errorOut(code, msg, argptr);
     va_end(argptr);
 }
 
+// Log this thread's errors and warnings to log, until errorLogEnd
+void errorLogBegin(ErrorLog *log) {
+    log->msgs = NULL;
+    log->used = log->avail = 0;
+    errorLog = log;
+}
+
+void errorLogEnd() {
+    errorLog = NULL;
+}
+
+// Send out a logged message, already formatted
+static void errorLogOut(ErrorLogMsg *logmsg, ...) {
+    va_list argptr;
+    va_start(argptr, logmsg);
+    if (logmsg->hasloc)
+        errorOutLoc(logmsg->srcloc, logmsg->code, "%s", argptr);
+    else
+        errorOut(logmsg->code, "%s", argptr);
+    va_end(argptr);
+}
+
+// Send out the logged errors and warnings (counting them)
+void errorLogReplay(ErrorLog *log) {
+    int i;
+    for (i = 0; i < log->used; ++i)
+        errorLogOut(&log->msgs[i], log->msgs[i].text);
+}
+
 // Generate final message for a compile
 void errorSummary() {
     float dur;
+    size_t live, peak;
     if (errors > 0)
         errorExit(ExitError, "Unsuccessful compile: %d errors, %d warnings", errors, warnings);
-    dur = (float)(clock()-startTime)/CLOCKS_PER_SEC;
-    fprintf(stderr, "Compile finished in %f sec (%lu kb). %d warnings detected\n", dur, memUsed()/1024, warnings);
+    dur = (float)(statsWallClock() - startTime);
+    live = memUsed(&peak, NULL);
+    fprintf(stderr, "Compile finished in %f sec (%lu kb, %lu kb peak). %d warnings detected\n",
+        dur, (unsigned long)live/1024, (unsigned long)peak/1024, warnings);
 }
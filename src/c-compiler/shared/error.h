@@ -70,6 +70,8 @@ enum ErrorCode {
     ErrorBadArray,  // Bad array
     ErrorBadSlice,  // Bad slice type
     ErrorMove,      // Move error of some kind
+    ErrorBigLit,    // Number literal is too big for its type
+    ErrorNoFile,    // Source file cannot be found or read
 
     // Warnings
     WarnCode = 3000,
@@ -87,4 +89,20 @@ void errorMsgLex(int code, const char *msg, ...);
 void errorMsg(int code, const char *msg, ...);
 void errorSummary();
 
+// While a thread parses files in parallel with others, its errors are logged rather
+// than sent out, to be replayed file by file, in the same order every time.
+typedef struct ErrorLogMsg ErrorLogMsg;
+typedef struct ErrorLog {
+    ErrorLogMsg *msgs;
+    int used;
+    int avail;
+} ErrorLog;
+
+// Log this thread's errors and warnings to log, until errorLogEnd
+void errorLogBegin(ErrorLog *log);
+void errorLogEnd();
+
+// Send out the logged errors and warnings (counting them)
+void errorLogReplay(ErrorLog *log);
+
 #endif
\ No newline at end of file
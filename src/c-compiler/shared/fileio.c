@@ -11,9 +11,25 @@
 #include <stdio.h>
 #include <string.h>
 #include <stddef.h>
-
-/** Load a file into an allocated string, return pointer or NULL if not found */
-char *fileLoad(char *fn) {
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#elif defined(__APPLE__)
+#include <mach-o/dyld.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/** Read a file into an allocated string, return pointer or NULL if not found */
+static char *fileRead(char *fn) {
     FILE *file;
     size_t filesize;
     char *filestr;
@@ -35,6 +51,83 @@ char *fileLoad(char *fn) {
     return filestr;
 }
 
+#ifdef _WIN32
+/** Load a file into an allocated string, return pointer or NULL if not found */
+char *fileLoad(char *fn) {
+    return fileRead(fn);
+}
+#else
+/** Map a file read-only into memory, return pointer or NULL if not found.
+ * The contents are 0-terminated without copying them: the mapping reaches past
+ * the end of the file into zero-filled memory, either the rest of the file's
+ * last page or else an extra anonymous page mapped just after it.
+ * The mapping is never unmapped, as source text lives as long as the compile. */
+char *fileLoad(char *fn) {
+    struct stat st;
+    size_t page, maplen;
+    char *filestr;
+    int fd;
+
+    // Open the file - return null on failure
+    if ((fd = open(fn, O_RDONLY)) < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return fileRead(fn);
+    }
+
+    // Reserve zero-filled pages enough for the file plus its terminator,
+    // then map the file over their start
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    maplen = ((size_t)st.st_size + page) & ~(page - 1);
+    filestr = (char *)mmap(NULL, maplen, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (filestr != (char *)MAP_FAILED
+        && mmap(filestr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(filestr, maplen);
+        filestr = (char *)MAP_FAILED;
+    }
+    close(fd);
+
+    // If it cannot be mapped, read it in instead
+    return filestr != (char *)MAP_FAILED ? filestr : fileRead(fn);
+}
+#endif
+
+/** Return the path of the running compiler's executable, or NULL if it can't be found */
+char *fileExePath() {
+#ifdef _WIN32
+    static char path[MAX_PATH];
+    DWORD len = GetModuleFileNameA(NULL, path, sizeof(path));
+    return len > 0 && len < sizeof(path) ? path : NULL;
+#elif defined(__APPLE__)
+    static char path[4096];
+    uint32_t size = sizeof(path);
+    return _NSGetExecutablePath(path, &size) == 0 ? path : NULL;
+#else
+    return "/proc/self/exe";
+#endif
+}
+
+/** Write a buffer to a file in one go ("-" writes to stdout). Return 0 on failure */
+int fileWrite(char *fn, char *buf, size_t size) {
+    FILE *file;
+    size_t written;
+
+    if (strcmp(fn, "-") == 0) {
+        file = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    else if (!(file = fopen(fn, "wb")))
+        return 0;
+
+    written = fwrite(buf, 1, size, file);
+    if (file == stdout)
+        return fflush(stdout) == 0 && written == size;
+    return fclose(file) == 0 && written == size;
+}
+
 /** Extract a filename only (no extension) from a path */
 char *fileName(char *fn) {
     char *dotp;
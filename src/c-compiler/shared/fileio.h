@@ -8,9 +8,18 @@
 #ifndef fileio_h
 #define fileio_h
 
-// Load a file into an allocated string, return pointer or NULL if not found
+#include <stddef.h>
+
+// Load a file as a 0-terminated, read-only string (mapped where possible),
+// return pointer or NULL if not found
 char *fileLoad(char *fn);
 
+// Return the path of the running compiler's executable, or NULL if it can't be found
+char *fileExePath();
+
+// Write a buffer to a file in one go ("-" writes to stdout). Return 0 on failure
+int fileWrite(char *fn, char *buf, size_t size);
+
 // Extract a filename only (no extension) from a path
 char *fileName(char *fn);
 
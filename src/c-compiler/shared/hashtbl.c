@@ -0,0 +1,58 @@
+/** Open-addressing hash tables probed a group of slots at a time
+ * @file
+ *
+ * The design follows Abseil's SwissTable: a hash's low 7 bits go into the slot's
+ * control byte, and the rest pick the group where probing starts.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "hashtbl.h"
+#include "memory.h"
+
+#include <string.h>
+
+// Allocate a table of avail slots, all empty
+static void hashTblAlloc(HashTbl *tbl, size_t avail) {
+    tbl->avail = avail;
+    tbl->used = 0;
+    tbl->ctrl = (uint8_t *)memAllocBlk(avail + avail * tbl->slotsz);
+    tbl->slots = (char *)tbl->ctrl + avail;
+    memset(tbl->ctrl, HashEmpty, avail);
+}
+
+// Allocate and initialize a hash table with at least avail empty slots
+void hashTblInit(HashTbl *tbl, size_t avail, size_t slotsz) {
+    size_t size = HashGroup;
+    while (size < avail)
+        size <<= 1;
+    tbl->slotsz = slotsz;
+    hashTblAlloc(tbl, size);
+}
+
+// Double the size of a hash table, rehashing its slots with slothash
+// (which returns the hash of a slot's key). The old table is freed.
+void hashTblGrow(HashTbl *tbl, size_t (*slothash)(void *slot)) {
+    uint8_t *oldctrl = tbl->ctrl;
+    char *oldslots = tbl->slots;
+    size_t oldavail = tbl->avail;
+    size_t oldslot;
+
+    hashTblAlloc(tbl, oldavail << 1);
+
+    // Copy existing slots to re-hashed positions. All keys are distinct,
+    // so nothing needs comparing: each goes in the first empty slot found.
+    for (oldslot = 0; oldslot < oldavail; oldslot++) {
+        if (oldctrl[oldslot] != HashEmpty) {
+            char *slotp = oldslots + oldslot * tbl->slotsz;
+            size_t hash = slothash(slotp);
+            size_t idx;
+            int found;
+            hashTblFind(tbl, hash, idx, found, 0);
+            hashTblClaim(tbl, idx, hash);
+            memcpy(hashTblSlot(tbl, idx, char), slotp, tbl->slotsz);
+        }
+    }
+    memFreeBlk(oldctrl, oldavail + oldavail * tbl->slotsz);
+}
@@ -0,0 +1,121 @@
+/** Open-addressing hash tables probed a group of slots at a time
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef hashtbl_h
+#define hashtbl_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HASHTBL_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// A hash table's slots hold entries of any (fixed) size, which the table's user
+// defines along with how to tell if a slot holds the key being looked for.
+// Besides the slots, the table keeps one control byte per slot: either HashEmpty
+// or 7 bits of the hash of the slot's key. A lookup checks a group of 16 control
+// bytes at once (with one SSE2 compare), only looking at the slots whose byte
+// matches its key's, and stops at the first group with an empty slot.
+// Slots are never removed, and the table doubles once 7/8 of it is used.
+typedef struct HashTbl {
+    uint8_t *ctrl;    // Control bytes, one per slot
+    char *slots;      // Slot array (allocated just after the control bytes)
+    size_t avail;     // Number of slots (power of 2, at least HashGroup)
+    size_t used;      // Number of slots used
+    size_t slotsz;    // Size of a slot in bytes
+} HashTbl;
+
+#define HashEmpty 0x80
+#define HashGroup 16
+
+// Allocate and initialize a hash table with at least avail empty slots
+void hashTblInit(HashTbl *tbl, size_t avail, size_t slotsz);
+
+// Double the size of a hash table, rehashing its slots with slothash
+// (which returns the hash of a slot's key). The old table is freed.
+void hashTblGrow(HashTbl *tbl, size_t (*slothash)(void *slot));
+
+// Return 1 if the table should grow before another slot is used
+#define hashTblFull(tbl) ((tbl)->used >= (tbl)->avail - ((tbl)->avail >> 3))
+
+// Point to the slot at idx, as a pointer to type
+#define hashTblSlot(tbl, idx, type) ((type *)((tbl)->slots + (idx) * (tbl)->slotsz))
+
+// Is the slot at idx empty?
+#define hashTblEmpty(tbl, idx) ((tbl)->ctrl[idx] == HashEmpty)
+
+// Mark the empty slot at idx (found by hashTblFind) as used by a key with hash
+#define hashTblClaim(tbl, idx, hash) ((tbl)->ctrl[idx] = (uint8_t)((hash) & 0x7f), ++(tbl)->used)
+
+// Index of the lowest set bit of a non-zero mask
+#ifdef _MSC_VER
+static inline unsigned hashCtz(unsigned bits) { unsigned long i; _BitScanForward(&i, bits); return i; }
+#else
+#define hashCtz(bits) ((unsigned)__builtin_ctz(bits))
+#endif
+
+// Bit mask of the control bytes in a group matching a hash's 7-bit tag
+static inline unsigned hashGroupMatch(const uint8_t *ctrl, uint8_t tag) {
+#ifdef HASHTBL_SSE2
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#else
+    unsigned bits = 0, i;
+    for (i = 0; i < HashGroup; ++i)
+        bits |= (unsigned)(ctrl[i] == tag) << i;
+    return bits;
+#endif
+}
+
+// Bit mask of the empty slots in a group (only empty control bytes have the top bit set)
+static inline unsigned hashGroupEmpty(const uint8_t *ctrl) {
+#ifdef HASHTBL_SSE2
+    return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    unsigned bits = 0, i;
+    for (i = 0; i < HashGroup; ++i)
+        bits |= (unsigned)(ctrl[i] >> 7) << i;
+    return bits;
+#endif
+}
+
+// Look up a key by its hash. For each slot whose control byte matches the hash,
+// the expression 'match' (which may use idx) says whether the slot holds the key.
+// Afterwards, found is 1 and idx is the key's slot, or else found is 0 and idx is
+// the empty slot where the key belongs. Groups are probed quadratically.
+#define hashTblFind(tbl, hash, idx, found, match) \
+{ \
+    size_t grpmask = ((tbl)->avail / HashGroup) - 1; \
+    size_t grp = ((size_t)(hash) >> 7) & grpmask, step = 0; \
+    uint8_t tag = (uint8_t)((hash) & 0x7f); \
+    found = 0; \
+    for (;;) { \
+        const uint8_t *grpctrl = &(tbl)->ctrl[grp * HashGroup]; \
+        unsigned bits; \
+        for (bits = hashGroupMatch(grpctrl, tag); bits; bits &= bits - 1) { \
+            idx = grp * HashGroup + hashCtz(bits); \
+            if (match) { \
+                found = 1; \
+                break; \
+            } \
+        } \
+        if (found) \
+            break; \
+        if ((bits = hashGroupEmpty(grpctrl))) { \
+            idx = grp * HashGroup + hashCtz(bits); \
+            break; \
+        } \
+        grp = (grp + ++step) & grpmask; \
+    } \
+}
+
+#endif
@@ -0,0 +1,265 @@
+/** Parallel worker jobs
+ * @file
+ *
+ * The compiler keeps nearly all its state in globals (name table, arenas, LLVM context).
+ * Rather than make all of that thread-safe, parallel work is handed to forked worker
+ * processes. Each worker inherits a copy-on-write snapshot of everything built so far,
+ * does its share of the work, and streams its results back to the parent over a pipe.
+ *
+ * Parsing is the exception. The state it touches (name table, arenas, lexer) is
+ * thread-safe, and what it builds must end up in the parent anyway, so it runs
+ * on a pool of threads instead.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "jobs.h"
+#include "error.h"
+#include "memory.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// Write all of a buffer to a pipe
+static int jobsWrite(int fd, char *buf, size_t size) {
+    while (size) {
+        ssize_t cnt = write(fd, buf, size);
+        if (cnt <= 0)
+            return 0;
+        buf += cnt;
+        size -= cnt;
+    }
+    return 1;
+}
+
+// Read everything a worker sends until it closes its pipe
+static char *jobsRead(int fd, size_t *size) {
+    size_t avail = 1 << 16;
+    char *buf = (char *)malloc(avail);
+    *size = 0;
+    while (buf) {
+        ssize_t cnt;
+        if (*size == avail) {
+            avail <<= 1;
+            buf = (char *)realloc(buf, avail);
+            if (buf == NULL)
+                break;
+        }
+        cnt = read(fd, buf + *size, avail - *size);
+        if (cnt <= 0)
+            break;
+        *size += cnt;
+    }
+    if (buf == NULL)
+        errorExit(ExitMem, "Error: Out of memory");
+    return buf;
+}
+
+// Run 'nbr' workers in parallel, each in a forked copy of the compiler's current state.
+int jobsFork(int nbr, JobsWorker worker, void *context, char **results, size_t *sizes) {
+    pid_t *pids;
+    int *fds;
+    int ok = 1;
+    int i;
+
+    // Stats and trace events are recorded by this process, so a forked worker's
+    // would be lost: when measuring, callers do the work serially instead
+    if (statsOn || traceOn)
+        return -1;
+    pids = (pid_t *)malloc(nbr * sizeof(pid_t));
+    fds = (int *)malloc(nbr * sizeof(int));
+
+    // Make sure buffered output is not duplicated into every worker
+    fflush(stdout);
+    fflush(stderr);
+
+    for (i = 0; i < nbr; ++i) {
+        int pipefd[2];
+        if (pipe(pipefd) != 0 || (pids[i] = fork()) < 0)
+            errorExit(ExitError, "Error: Could not start worker job");
+
+        // Worker: do the job, send back its results, and quit
+        if (pids[i] == 0) {
+            char *result;
+            size_t size;
+            close(pipefd[0]);
+            result = worker(i, context, &size);
+            _exit(result && jobsWrite(pipefd[1], result, size) ? ExitSuccess : ExitError);
+        }
+        close(pipefd[1]);
+        fds[i] = pipefd[0];
+    }
+
+    // Collect every worker's results, in order
+    for (i = 0; i < nbr; ++i) {
+        int status;
+        results[i] = jobsRead(fds[i], &sizes[i]);
+        close(fds[i]);
+        if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != ExitSuccess)
+            ok = 0;
+    }
+
+    free(pids);
+    free(fds);
+    return ok;
+}
+
+#else
+
+// Windows has no fork(): callers fall back to doing the work serially
+int jobsFork(int nbr, JobsWorker worker, void *context, char **results, size_t *sizes) {
+    return -1;
+}
+
+#endif
+
+// Threads, and a lock with a condition to wait on
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE JobsThread;
+#define jobsLock(pool) AcquireSRWLockExclusive(&(pool)->lock)
+#define jobsUnlock(pool) ReleaseSRWLockExclusive(&(pool)->lock)
+#define jobsWait(pool) SleepConditionVariableSRW(&(pool)->cond, &(pool)->lock, INFINITE, 0)
+#define jobsWake(pool) WakeConditionVariable(&(pool)->cond)
+#define jobsWakeAll(pool) WakeAllConditionVariable(&(pool)->cond)
+#else
+#include <pthread.h>
+typedef pthread_t JobsThread;
+#define jobsLock(pool) pthread_mutex_lock(&(pool)->lock)
+#define jobsUnlock(pool) pthread_mutex_unlock(&(pool)->lock)
+#define jobsWait(pool) pthread_cond_wait(&(pool)->cond, &(pool)->lock)
+#define jobsWake(pool) pthread_cond_signal(&(pool)->cond)
+#define jobsWakeAll(pool) pthread_cond_broadcast(&(pool)->cond)
+#endif
+
+// A pool of threads, running a task on every item added to it
+struct JobsPool {
+    JobsTask task;
+    void **items;        // Items waiting to be run (most recently added last)
+    int used;
+    int avail;
+    int running;        // Items being run right now
+    int finishing;        // Has jobsPoolFinish been called (so no more items come from outside)?
+    int done;            // Are all items run, with no more to come?
+    int nbr;            // Number of threads
+    JobsThread *threads;
+#ifdef _WIN32
+    SRWLOCK lock;
+    CONDITION_VARIABLE cond;    // Signalled when an item is added or all are done
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+};
+
+// Run the pool's items, one at a time, until all are done
+static void jobsPoolRun(JobsPool *pool) {
+    jobsLock(pool);
+    while (1) {
+        void *item;
+        while (pool->used == 0 && !pool->done)
+            jobsWait(pool);
+        if (pool->used == 0)
+            break;
+        item = pool->items[--pool->used];
+        ++pool->running;
+        jobsUnlock(pool);
+        pool->task(item);
+        jobsLock(pool);
+        if (--pool->running == 0 && pool->used == 0 && pool->finishing) {
+            pool->done = 1;
+            jobsWakeAll(pool);
+        }
+    }
+    jobsUnlock(pool);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI jobsPoolThread(LPVOID pool) {
+    jobsPoolRun((JobsPool *)pool);
+    memThreadDone();
+    return 0;
+}
+#else
+static void *jobsPoolThread(void *pool) {
+    jobsPoolRun((JobsPool *)pool);
+    memThreadDone();
+    return NULL;
+}
+#endif
+
+// Start a pool of 'nbr' threads (besides the caller's), which run task on each item added
+JobsPool *jobsPoolStart(int nbr, JobsTask task) {
+    JobsPool *pool = (JobsPool *)calloc(1, sizeof(JobsPool));
+    int i;
+    if (pool == NULL || (pool->threads = (JobsThread *)malloc(nbr * sizeof(JobsThread))) == NULL)
+        errorExit(ExitMem, "Error: Out of memory");
+    pool->task = task;
+#ifdef _WIN32
+    InitializeSRWLock(&pool->lock);
+    InitializeConditionVariable(&pool->cond);
+#else
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+#endif
+    for (i = 0; i < nbr; ++i) {
+#ifdef _WIN32
+        if ((pool->threads[i] = CreateThread(NULL, 0, jobsPoolThread, pool, 0, NULL)) == NULL)
+#else
+        if (pthread_create(&pool->threads[i], NULL, jobsPoolThread, pool) != 0)
+#endif
+            errorExit(ExitError, "Error: Could not start worker thread");
+        ++pool->nbr;
+    }
+    return pool;
+}
+
+// Add an item for the pool to run its task on
+void jobsPoolAdd(JobsPool *pool, void *item) {
+    jobsLock(pool);
+    if (pool->used == pool->avail) {
+        pool->avail = pool->avail == 0 ? 64 : pool->avail << 1;
+        if ((pool->items = (void **)realloc(pool->items, pool->avail * sizeof(void *))) == NULL)
+            errorExit(ExitMem, "Error: Out of memory");
+    }
+    pool->items[pool->used++] = item;
+    jobsWake(pool);
+    jobsUnlock(pool);
+}
+
+// Help run the pool's items until all are done, then stop its threads
+void jobsPoolFinish(JobsPool *pool) {
+    int i;
+    jobsLock(pool);
+    pool->finishing = 1;
+    if (pool->running == 0 && pool->used == 0) {
+        pool->done = 1;
+        jobsWakeAll(pool);
+    }
+    jobsUnlock(pool);
+    jobsPoolRun(pool);
+
+    for (i = 0; i < pool->nbr; ++i) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+#ifndef _WIN32
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+#endif
+    free(pool->threads);
+    free(pool->items);
+    free(pool);
+}
@@ -0,0 +1,37 @@
+/** Parallel worker jobs
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef jobs_h
+#define jobs_h
+
+#include <stddef.h>
+
+// A worker is handed its index (0 to nbr-1) and the caller's context.
+// It returns a buffer of results (and its size) to send back to the parent,
+// or NULL if it failed.
+typedef char *(*JobsWorker)(int index, void *context, size_t *size);
+
+// Run 'nbr' workers in parallel, each in a forked copy of the compiler's current state.
+// Returns 1 if all workers succeed, filling in results[] and sizes[] with their output.
+// Returns 0 if any worker failed, and -1 if forked workers are not supported
+// (or not wanted, as when collecting stats or a trace): the caller then does the work serially.
+int jobsFork(int nbr, JobsWorker worker, void *context, char **results, size_t *sizes);
+
+// A pool of threads, sharing the compiler's state, that runs a task on every item added to it
+typedef struct JobsPool JobsPool;
+typedef void (*JobsTask)(void *item);
+
+// Start a pool of 'nbr' threads (besides the caller's), which run task on each item added
+JobsPool *jobsPoolStart(int nbr, JobsTask task);
+
+// Add an item for the pool to run its task on. A running task may add more items.
+void jobsPoolAdd(JobsPool *pool, void *item);
+
+// Help run the pool's items until all are done (including any they added), then stop its threads
+void jobsPoolFinish(JobsPool *pool);
+
+#endif
@@ -2,8 +2,28 @@
  * @file
  *
  * The compiler's memory management is deliberately leaky for high performance.
- * Allocation is done via bump pointer within very large arenas allocated from the heap
- * Nothing is ever freed.
+ * Allocation is done via bump pointer within very large arenas. Each arena is a big
+ * reservation of address space, which grows in place by committing memory to it
+ * as needed (using huge pages, where available). Arenas fall back to blocks
+ * allocated from the heap, should reserving address space fail.
+ * Almost nothing is ever freed, with two exceptions:
+ *
+ * - Tables that grow by reallocation (name table, namespaces, flow stacks, ...) hand
+ *   their old block back with memFreeBlk. Arena blocks go on a free list, to be reused
+ *   by a later allocation of the same size. Big blocks go straight back to the heap.
+ * - Transient buffers (e.g., argument arrays handed to LLVM) come from a separate
+ *   scratch arena, which is released back to an earlier mark once they are done.
+ *
+ * This way, peak memory use reflects live data, rather than every table ever outgrown.
+ *
+ * Every thread has its own arenas, free lists and scratch arena, so allocation never
+ * takes a lock. Memory is not owned by the thread that allocated it, though: any thread
+ * may use (or free) it. When a thread is done, memThreadDone hands its arenas off to
+ * the next thread to start allocating. memUsed totals the bookkeeping of all threads.
+ *
+ * Each thread also keeps its own high-water mark of live memory, sampled whenever
+ * it grows an arena or takes a big block from the heap, so that the peak reflects
+ * memory used (and given back) between the times memUsed is called.
  *
  * This source file is part of the Cone Programming Language C compiler
  * See Copyright Notice in conec.h
@@ -17,97 +37,462 @@
 #include <string.h>
 #include <stddef.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Thread-local storage, plus atomic compare-and-swap and (acquiring) load of a pointer-sized value
+#ifdef _MSC_VER
+#define MemThreadLocal __declspec(thread)
+#define memCas(ptr, old, new) (InterlockedCompareExchangePointer((PVOID volatile *)(ptr), (PVOID)(new), (PVOID)(old)) == (PVOID)(old))
+#define memLoad(ptr) (*(volatile void **)(ptr))
+#else
+#define MemThreadLocal __thread
+#define memCas(ptr, old, new) __sync_bool_compare_and_swap((ptr), (old), (new))
+#define memLoad(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#endif
+
 // Public globals: Arena size configuration values
 size_t gMemBlkArenaSize = 256 * 4096;
 size_t gMemStrArenaSize = 128 * 4096;
 
-// Private globals: memory allocation arena bookkeeping
-static void *gMemBlkArenaPos = NULL;
-static size_t gMemBlkArenaLeft = 0;
-static void *gMemStrArenaPos = NULL;
-static size_t gMemStrArenaLeft = 0;
+// Configurable size for scratch arena chunks (multiple of 4096 byte pages)
+size_t gMemScratchSize = 16 * 4096;
+
+// An arena hands out memory by bumping a pointer through its committed memory.
+// When it has a reservation of address space, it grows in place by committing
+// more of it. Otherwise (or once the reservation is used up), it moves on to a
+// new block from the heap, wasting whatever was left at the end of the old one.
+typedef struct MemArena {
+    char *pos;        // Next free byte
+    size_t left;    // Committed bytes left after pos
+    char *limit;    // End of the reservation pos is within (NULL if none)
+    int reserved;    // Has a reservation been attempted?
+} MemArena;
+
+// Blocks freed for reuse, kept in lists by size class (log2 of size).
+// Each free block holds the next free block of its class, and its own size.
+typedef struct MemFree {
+    struct MemFree *next;
+    size_t size;
+} MemFree;
+#define MemFreeMin 256            // Smaller blocks are not worth tracking for reuse
+
+// The scratch arena is a chain of chunks, each starting with this header
+typedef struct MemChunk {
+    struct MemChunk *prev;    // Chunk allocated before this one
+    size_t size;            // Size of chunk, including header
+    size_t tail;            // Unused space left at end of prev, when this chunk began
+} MemChunk;
+
+// A thread's memory allocation bookkeeping
+typedef struct MemThread {
+    struct MemThread *next;    // Next in the list of all threads' bookkeeping
+    size_t busy;            // 1 while a thread is using it
+    MemArena blk;            // Arena for blocks
+    MemArena str;            // Arena for strings
+    size_t allocated;        // Memory allocated (or committed) by this thread, net of frees
+    size_t tails;            // Unused space at the end of outgrown arenas
+    MemFree *freelists[64];    // Freed blocks, by size class
+    size_t freebytes;        // Total size of freed blocks
+    MemChunk *scratch;        // Current (most recently allocated) scratch chunk
+    char *scratchpos;
+    size_t scratchleft;
+    size_t scratchtails;    // Unused space at the end of all scratch chunks but the current one
+    size_t peak;            // Highest live memory this thread has seen
+} MemThread;
+
+static MemThreadLocal MemThread *gMemThread = NULL;    // This thread's bookkeeping
+static MemThread *gMemThreads = NULL;    // All threads' bookkeeping (never removed)
+
+// Start this thread's bookkeeping, adopting what a finished thread left behind, if any
+static MemThread *memThreadStart() {
+    MemThread *mt;
+    for (mt = (MemThread *)memLoad(&gMemThreads); mt; mt = mt->next) {
+        if (memCas(&mt->busy, 0, 1))
+            return gMemThread = mt;
+    }
+    mt = (MemThread *)calloc(1, sizeof(MemThread));
+    if (mt == NULL)
+        errorExit(ExitMem, "Error: Out of memory");
+    mt->busy = 1;
+    do
+        mt->next = gMemThreads;
+    while (!memCas(&gMemThreads, mt->next, mt));
+    return gMemThread = mt;
+}
+
+// Return this thread's bookkeeping
+#define memThread() (gMemThread ? gMemThread : memThreadStart())
+
+// This thread is done allocating. Its arenas (and everything allocated from them)
+// stay as they are, for the next thread that starts allocating to carry on with.
+void memThreadDone() {
+    MemThread *mt = gMemThread;
+    if (mt == NULL)
+        return;
+    gMemThread = NULL;
+    memCas(&mt->busy, 1, 0);
+}
+
+// Memory live for a thread: what it allocated (net of frees), less what is unused or wasted.
+// As blocks may be freed by another thread than allocated them, it can (briefly) be negative.
+#define memThreadLive(mt) ((mt)->allocated - (mt)->blk.left - (mt)->str.left - (mt)->scratchleft \
+    - (mt)->tails - (mt)->freebytes - (mt)->scratchtails)
+
+// Raise this thread's high-water mark, if live memory (plus 'size' about to be used) is above it
+static void memPeakMark(MemThread *mt, size_t size) {
+    size_t live = memThreadLive(mt) + size;
+    if ((ptrdiff_t)live > (ptrdiff_t)mt->peak)
+        mt->peak = live;
+}
+
+// Blocks bigger than this are allocated from (and freed back to) the heap
+#define memBigBlk() (gMemBlkArenaSize >> 3)
+
+// Return the size class (log2) of a block's size
+static int memSizeClass(size_t size) {
+    int class = 0;
+    while (size >>= 1)
+        ++class;
+    return class;
+}
+
+// Reuse a freed block of exactly this size, if there is one
+static void *memReuseBlk(MemThread *mt, size_t size) {
+    MemFree **freep;
+    for (freep = &mt->freelists[memSizeClass(size)]; *freep; freep = &(*freep)->next) {
+        if ((*freep)->size == size) {
+            MemFree *blk = *freep;
+            *freep = blk->next;
+            mt->freebytes -= size;
+            return blk;
+        }
+    }
+    return NULL;
+}
+
+// ************************ Arenas *******************************
+
+// Address space reserved for each arena. Only what is committed uses memory.
+#define MemReserve (sizeof(void*) >= 8 ? (size_t)64 << 30 : (size_t)256 << 20)
+
+// Huge pages are this big (on x86-64 and most aarch64 Linux systems).
+// A reservation is aligned to them and committed in multiples of them,
+// so that the kernel can back the arenas with huge pages.
+#define MemHugePage ((size_t)2 << 20)
+
+#ifdef _WIN32
+
+// Reserve address space, without committing any memory to it
+static char *memReserve(size_t size) {
+    return (char *)VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+// Commit memory to part of a reservation
+static int memCommit(char *start, size_t size) {
+    return VirtualAlloc(start, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+#else
+
+// Reserve address space, without committing any memory to it.
+// Ask for huge pages, to cut TLB misses and page faults walking a big IR.
+static char *memReserve(size_t size) {
+    char *base = (char *)mmap(NULL, size + MemHugePage, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == (char *)MAP_FAILED)
+        return NULL;
+    base = (char *)(((size_t)base + MemHugePage - 1) & ~(MemHugePage - 1));
+#ifdef MADV_HUGEPAGE
+    madvise(base, size, MADV_HUGEPAGE);
+#endif
+    return base;
+}
+
+// Commit memory to part of a reservation
+static int memCommit(char *start, size_t size) {
+    return mprotect(start, size, PROT_READ | PROT_WRITE) == 0;
+}
+#endif
+
+#ifdef CONE_COMPRESSED_IR
+// With compressed IR references, every thread's block arena is carved out of one
+// shared reservation, so that any block can be referred to by its 32-bit offset
+// (in 16-byte units) from the reservation's base. The first huge page of it is
+// never handed out, so that no block has the offset 0 (which means NULL).
+char *gMemRefBase = NULL;
+static char *gMemRefNext = NULL;    // Start of the shared reservation not yet claimed
+static char *gMemRefLimit = NULL;
+
+// Grow a block arena by claiming the next part of the shared reservation.
+// It grows in place if no other thread has claimed any since the arena last grew.
+static int memRefGrow(MemThread *mt, MemArena *arena, size_t size, size_t step) {
+    char *start;
+    size_t grow;
+
+    // The first allocation (before any other thread starts) makes the reservation
+    if (gMemRefBase == NULL) {
+        size_t reserve;
+        for (reserve = MemReserve; reserve >= MemHugePage << 5; reserve >>= 1) {
+            if ((gMemRefBase = memReserve(reserve))) {
+                gMemRefNext = gMemRefBase + MemHugePage;
+                gMemRefLimit = gMemRefBase + reserve;
+                break;
+            }
+        }
+        if (gMemRefBase == NULL)
+            errorExit(ExitMem, "Error: Out of memory (could not reserve address space for the IR)");
+    }
+
+    step = (step + MemHugePage - 1) & ~(MemHugePage - 1);
+    grow = (size + step - 1) / step * step;
+    do {
+        start = (char *)memLoad(&gMemRefNext);
+        if (grow > (size_t)(gMemRefLimit - start))
+            errorExit(ExitMem, "Error: Out of memory (the IR outgrew its reserved address space)");
+    } while (!memCas(&gMemRefNext, start, start + grow));
+    if (!memCommit(start, grow))
+        errorExit(ExitMem, "Error: Out of memory");
+
+    if (start != arena->pos + arena->left) {
+        mt->tails += arena->left;
+        arena->pos = start;
+        arena->left = 0;
+    }
+    arena->left += grow;
+    mt->allocated += grow;
+    return 1;
+}
+#endif
+
+// Grow an arena in place to fit 'size' more bytes, committing in multiples of 'step'.
+// Returns 0 if it has no reservation (left) to grow into.
+static int memArenaGrow(MemThread *mt, MemArena *arena, size_t size, size_t step) {
+    char *end;
+    size_t grow;
+
+#ifdef CONE_COMPRESSED_IR
+    if (arena == &mt->blk)
+        return memRefGrow(mt, arena, size, step);
+#endif
+
+    // Reserve address space the first time the arena needs room.
+    // If that much can't be had (e.g., ulimit -v), settle for less.
+    if (!arena->reserved) {
+        size_t reserve;
+        arena->reserved = 1;
+        for (reserve = MemReserve; reserve >= MemHugePage << 5; reserve >>= 1) {
+            if ((arena->pos = memReserve(reserve))) {
+                arena->limit = arena->pos + reserve;
+                break;
+            }
+        }
+    }
+    if (arena->limit == NULL)
+        return 0;
+
+    end = arena->pos + arena->left;
+    step = (step + MemHugePage - 1) & ~(MemHugePage - 1);
+    grow = (size - arena->left + step - 1) / step * step;
+    if (grow > (size_t)(arena->limit - end))
+        grow = arena->limit - end;
+    if (grow < size - arena->left || !memCommit(end, grow)) {
+        arena->limit = NULL;
+        return 0;
+    }
+    arena->left += grow;
+    mt->allocated += grow;
+    return 1;
+}
+
+// Allocate from an arena, growing it by at least 'step' bytes if it is full
+static void *memArenaAlloc(MemThread *mt, MemArena *arena, size_t size, size_t step) {
+    void *memp;
+    if (size > arena->left)
+        memPeakMark(mt, size);
+    if (size > arena->left && !memArenaGrow(mt, arena, size, step)) {
+        // Something bigger than a whole heap block gets one of its own
+        if (size > step) {
+            memp = malloc(size);
+            mt->allocated += size;
+            if (memp == NULL)
+                errorExit(ExitMem, "Error: Out of memory");
+            return memp;
+        }
 
-size_t memAllocated = 0;
+        // Move on to a new heap block
+        mt->tails += arena->left;
+        arena->pos = (char *)malloc(step);
+        mt->allocated += step;
+        if (arena->pos == NULL)
+            errorExit(ExitMem, "Error: Out of memory");
+        arena->left = step;
+    }
+    memp = arena->pos;
+    arena->pos += size;
+    arena->left -= size;
+    return memp;
+}
 
 /** Allocate memory for a block, aligned to a 16-byte boundary */
 void *memAllocBlk(size_t size) {
+    MemThread *mt = memThread();
     void *memp;
 
     // Align to 16-byte boundary
     size = (size + 15) & ~15;
 
-    // Return next bite out of arena, if it fits
-    if (size <= gMemBlkArenaLeft) {
-        gMemBlkArenaLeft -= size;
-        memp = gMemBlkArenaPos;
-        gMemBlkArenaPos = (char*)gMemBlkArenaPos + size;
+    // Reuse a freed block of the same size, if any
+    if (size >= MemFreeMin && mt->freebytes && (memp = memReuseBlk(mt, size)))
         return memp;
-    }
 
-    // Return a newly allocated area, if bigger than arena can hold
-    if (size > gMemBlkArenaSize) {
+    // Return a newly allocated area, if big enough to be worth returning to the heap when freed
+    if (size > memBigBlk()) {
         memp = malloc(size);
-        memAllocated += size;
         if (memp==NULL)
             errorExit(ExitMem, "Error: Out of memory");
+        memPeakMark(mt, size);
+        mt->allocated += size;
         return memp;
     }
 
-    // Allocate a new Arena and return next bite out of it
-    gMemBlkArenaPos = malloc(gMemBlkArenaSize);
-    memAllocated += gMemBlkArenaSize;
-    if (gMemBlkArenaPos==NULL)
-        errorExit(ExitMem, "Error: Out of memory");
-    gMemBlkArenaLeft = gMemBlkArenaSize - size;
-    memp = gMemBlkArenaPos;
-    gMemBlkArenaPos = (char*)gMemBlkArenaPos + size;
-    return memp;
+    return memArenaAlloc(mt, &mt->blk, size, gMemBlkArenaSize);
 }
 
 /** Allocate memory for a string and copy contents over, if not NULL
  * Allocates extra byte for string-ending 0, appending it to copied string */
 char *memAllocStr(char *str, size_t size) {
-    void *strp;
+    MemThread *mt = memThread();
+    char *strp;
 
     // Give it room for C-string null terminator
     size += 1;
+    strp = (char *)memArenaAlloc(mt, &mt->str, size, gMemStrArenaSize);
 
-    // Return next bite out of arena, if it fits
-    if (size <= gMemStrArenaLeft) {
-        gMemStrArenaLeft -= size;
-        strp = gMemStrArenaPos;
-        gMemStrArenaPos = (char*)gMemStrArenaPos + size;
+    // Copy string contents into it
+    if (str) {
+        strncpy(strp, str, --size);
+        *(strp+size) = '\0';
     }
+    return strp;
+}
 
-    // Return a newly allocated area, if bigger than arena can hold
-    else if (size > gMemStrArenaSize) {
-        strp = malloc(size);
-        memAllocated += size;
-        if (strp==NULL)
-            errorExit(ExitMem, "Error: Out of memory");
-    }
+// Free a block allocated by memAllocBlk (of the same size), once nothing refers to it.
+// It goes on this thread's free list, whichever thread allocated it.
+void memFreeBlk(void *blk, size_t size) {
+    MemThread *mt;
+    MemFree *freeblk = (MemFree *)blk;
+    int class;
 
-    // Allocate a new Arena and return next bite out of it
-    else {
-        gMemStrArenaPos = malloc(gMemStrArenaSize);
-        memAllocated += gMemStrArenaSize;
-        if (gMemStrArenaPos==NULL)
-            errorExit(ExitMem, "Error: Out of memory");
-        gMemStrArenaLeft = gMemStrArenaSize - size;
-        strp = gMemStrArenaPos;
-        gMemStrArenaPos = (char*)gMemStrArenaPos + size;
+    size = (size + 15) & ~15;
+    if (blk == NULL || size < MemFreeMin)
+        return;
+    mt = memThread();
+    if (size > memBigBlk()) {
+        free(blk);
+        mt->allocated -= size;
+        return;
     }
+    class = memSizeClass(size);
+    freeblk->size = size;
+    freeblk->next = mt->freelists[class];
+    mt->freelists[class] = freeblk;
+    mt->freebytes += size;
+}
 
-    // Copy string contents into it
-    if (str) {
-        strncpy((char*)strp, str, --size);
-        *((char*)strp+size) = '\0';
+// ************************ Scratch arena *******************************
+
+// Start a new scratch chunk big enough to hold a block of 'size' bytes
+static void memScratchChunk(MemThread *mt, size_t size) {
+    MemChunk *chunk;
+    size_t chunksize;
+    memPeakMark(mt, size);
+    chunksize = sizeof(MemChunk) + size > gMemScratchSize ? sizeof(MemChunk) + size : gMemScratchSize;
+    chunk = (MemChunk *)malloc(chunksize);
+    if (chunk == NULL)
+        errorExit(ExitMem, "Error: Out of memory");
+    mt->allocated += chunksize;
+    chunk->prev = mt->scratch;
+    chunk->size = chunksize;
+    chunk->tail = mt->scratchleft;
+    mt->scratchtails += mt->scratchleft;
+    mt->scratch = chunk;
+    mt->scratchpos = (char *)chunk + ((sizeof(MemChunk) + 15) & ~15);
+    mt->scratchleft = chunksize - ((sizeof(MemChunk) + 15) & ~15);
+}
+
+// Return the current position in the scratch arena, to later release back to.
+// The first chunk is never released, so scratch use does not churn the heap.
+MemMark memScratchMark() {
+    MemThread *mt = memThread();
+    MemMark mark;
+    if (mt->scratch == NULL)
+        memScratchChunk(mt, 0);
+    mark.chunk = mt->scratch;
+    mark.pos = mt->scratchpos;
+    mark.left = mt->scratchleft;
+    return mark;
+}
+
+// Allocate a transient block from the scratch arena, aligned to a 16-byte boundary
+void *memScratchAlloc(size_t size) {
+    MemThread *mt = memThread();
+    void *memp;
+    size = (size + 15) & ~15;
+    if (size > mt->scratchleft)
+        memScratchChunk(mt, size);
+    memp = mt->scratchpos;
+    mt->scratchpos += size;
+    mt->scratchleft -= size;
+    return memp;
+}
+
+// Release everything allocated from the scratch arena since the mark was taken
+void memScratchRelease(MemMark mark) {
+    MemThread *mt = memThread();
+    while (mt->scratch != mark.chunk) {
+        MemChunk *chunk = mt->scratch;
+        mt->scratch = chunk->prev;
+        mt->scratchtails -= chunk->tail;
+        mt->allocated -= chunk->size;
+        free(chunk);
     }
-    return (char*) strp;
+    mt->scratchpos = mark.pos;
+    mt->scratchleft = mark.left;
 }
 
 size_t nametblUnused();
-// Return how much memory actually needed for use
-size_t memUsed() {
-    return memAllocated - gMemBlkArenaLeft - gMemStrArenaLeft - nametblUnused();
+// Return how much memory is live (actually needed for use), totalled over all threads.
+// If not NULL, also return the peak live memory, and how much allocated memory is wasted:
+// unused name table slots, free blocks not yet reused, and unusable ends of arenas.
+// The peak adds up every thread's high-water mark (so may overstate a peak the threads
+// did not reach at the same time). Call it only while no other thread is allocating:
+// otherwise it is not even a close snapshot.
+size_t memUsed(size_t *peak, size_t *wasted) {
+    MemThread *mt;
+    size_t allocated = 0;
+    size_t left = 0;
+    size_t unused = nametblUnused();
+    size_t waste = unused;
+    size_t peaks = 0;
+    size_t live;
+
+    for (mt = (MemThread *)memLoad(&gMemThreads); mt; mt = mt->next) {
+        memPeakMark(mt, 0);
+        allocated += mt->allocated;
+        left += mt->blk.left + mt->str.left + mt->scratchleft;
+        waste += mt->tails + mt->freebytes + mt->scratchtails;
+        peaks += mt->peak;
+    }
+    live = allocated - left - waste;
+    // Threads' marks count the name table's unused slots, which are not per-thread
+    peaks = peaks > unused ? peaks - unused : 0;
+    if (peak)
+        *peak = peaks > live ? peaks : live;
+    if (wasted)
+        *wasted = waste;
+    return live;
 }
@@ -10,8 +10,10 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
 
-// Configurable size for arenas (specify as multiples of 4096 byte pages)
+// Configurable size by which arenas grow (specify as multiples of 4096 byte pages)
+// Settable with --arena-size and --str-arena-size
 size_t gMemBlkArenaSize;    // Default is 256 pages
 size_t gMemStrArenaSize;    // Default is 128 pages
 
@@ -22,7 +24,55 @@ void *memAllocBlk(size_t size);
 // Allocates extra byte for string-ending 0, appending it to copied string
 char *memAllocStr(char *str, size_t size);
 
-// Return memory allocated and used
-size_t memUsed();
+// A reference to a block allocated by memAllocBlk, for compact IR tables.
+// When built with CONE_COMPRESSED_IR, it is a 32-bit offset (in 16-byte units)
+// from the base of the address space all block arenas are carved from.
+// Otherwise, it is simply a pointer. memRef and memDeref convert, preserving NULL.
+// (Big blocks, over 1/8 of gMemBlkArenaSize, come from the heap: never refer to them.)
+// Only tables of references use MemRef: namespaces, name table hooks and IMethNodes.
+// Nodes lists and node fields (vtype, dclnode, owner, namesym) stay pointers, as passes
+// replace nodes in place through INode ** pointers into them (see bench/irbench.sh).
+#ifdef CONE_COMPRESSED_IR
+typedef uint32_t MemRef;
+extern char *gMemRefBase;
+#define memRef(p) ((MemRef)((p) ? (size_t)((char *)(p) - gMemRefBase) >> 4 : 0))
+#define memDeref(ref) ((void *)((ref) ? gMemRefBase + ((size_t)(ref) << 4) : NULL))
+#else
+typedef void *MemRef;
+#define memRef(p) ((MemRef)(p))
+#define memDeref(ref) ((void *)(ref))
+#endif
+
+// Free a block allocated by memAllocBlk (of the same size), once nothing refers to it.
+// It may be reused by a later allocation of the same size.
+void memFreeBlk(void *blk, size_t size);
+
+// Configurable size for scratch arena chunks
+size_t gMemScratchSize;    // Default is 16 pages
+
+// A position in the scratch arena, to release back to
+typedef struct MemMark {
+    void *chunk;
+    char *pos;
+    size_t left;
+} MemMark;
+
+// Return the current position in the scratch arena, to later release back to
+MemMark memScratchMark();
+
+// Allocate a transient block from the scratch arena, aligned to a 16-byte boundary.
+// It lasts only until the scratch arena is released back to an earlier mark.
+void *memScratchAlloc(size_t size);
+
+// Release everything allocated from the scratch arena since the mark was taken
+void memScratchRelease(MemMark mark);
+
+// This thread is done allocating. Everything it allocated stays valid, for any thread
+// to use, and its arenas are handed off to the next thread that starts allocating.
+void memThreadDone();
+
+// Return memory live (actually needed for use), totalled over all threads.
+// If not NULL, also return the peak live memory and the allocated memory wasted.
+size_t memUsed(size_t *peak, size_t *wasted);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,222 @@
+/** Persistent compile server
+ * @file
+ *
+ * Every compile repeats the same startup work: initializing LLVM's targets,
+ * creating the target machine, and building the name table and std library.
+ * A compile server does that once, then serves compile requests over a local socket.
+ *
+ * Each request is compiled by a forked copy of the server, which inherits a
+ * copy-on-write snapshot of its warm, pristine state. The compile can do as it
+ * likes with that state (and its arenas), since it all vanishes when it exits.
+ *
+ * A request carries the client's working directory and command line, plus
+ * its stdout and stderr, so the compile's output goes straight to the client.
+ * The forked copy reads the request and compiles it, then simply exits.
+ * The server reaps it and replies with its exit code (even if it crashed).
+ *
+ * Requests come from conecc (see conecc.c), as merely loading LLVM's shared
+ * library takes about as long as a small compile in the warm server. With it, a
+ * small compile takes about half as long as with conec (15-17 ms versus
+ * 29-30 ms: see bench/serverbench.sh). So the server suits many small compiles,
+ * as from a build tool or an editor. A big program gains nothing: its compile
+ * dwarfs the startup saved, and the forked copy's page faults cost a little.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "server.h"
+#include "error.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+// Receive the request's size, along with the client's stdout and stderr
+static int serverRecvHeader(int sock, uint32_t *size, int fds[2]) {
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = size;
+    iov.iov_len = sizeof(*size);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    if (recvmsg(sock, &msg, 0) != sizeof(*size))
+        return 0;
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+        || cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int)))
+        return 0;
+    memcpy(fds, CMSG_DATA(cmsg), 2 * sizeof(int));
+    return 1;
+}
+
+// Handle one client's request, in a forked copy of the warm server:
+// switch to the client's folder and output, compile, and exit with its exit code.
+// Returns only if the request is bad.
+static void serverHandle(int sock, ServerCompile compile) {
+    uint32_t size;
+    int fds[2];
+    char *request, *reqp, **argv;
+    int argc;
+
+    if (!serverRecvHeader(sock, &size, fds))
+        return;
+    request = (char *)malloc(size + 1);
+    if (request == NULL || !serverRead(sock, request, size))
+        return;
+    request[size] = '\0';
+    close(sock);
+
+    // The request is the working directory, then each argument, all null-terminated
+    argc = -1;
+    for (reqp = request; reqp < request + size; reqp += strlen(reqp) + 1)
+        ++argc;
+    if (argc < 1)
+        return;
+    argv = (char **)malloc((argc + 1) * sizeof(char *));
+    reqp = request + strlen(request) + 1;
+    for (argc = 0; reqp < request + size; reqp += strlen(reqp) + 1)
+        argv[argc++] = reqp;
+    argv[argc] = NULL;
+
+    dup2(fds[0], 1);
+    dup2(fds[1], 2);
+    close(fds[0]);
+    close(fds[1]);
+    if (chdir(request) != 0)
+        errorExit(ExitNF, "Error: Could not change to folder %s", request);
+    exit(compile(argc, argv));
+}
+
+// A compile that is underway: its process, and the socket to reply on when it exits
+typedef struct ServerJob {
+    pid_t pid;
+    int sock;
+} ServerJob;
+
+// A pipe the SIGCHLD handler writes to, to wake up the server's poll for replies
+static int serverWake[2];
+
+static void serverChildDone(int sig) {
+    int olderrno = errno;
+    if (write(serverWake[1], "", 1) < 0)
+        ;    // A full pipe wakes the server just the same
+    errno = olderrno;
+}
+
+// Reply to the clients of every compile that has finished
+static void serverReap(ServerJob *jobs, int *nbr) {
+    char buf[64];
+    pid_t pid;
+    int status, i;
+
+    while (read(serverWake[0], buf, sizeof(buf)) > 0);
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (i = 0; i < *nbr && jobs[i].pid != pid; ++i);
+        if (i == *nbr)
+            continue;
+        status = WIFEXITED(status) ? WEXITSTATUS(status) : ExitError;
+        serverWrite(jobs[i].sock, (char *)&status, sizeof(status));
+        close(jobs[i].sock);
+        jobs[i] = jobs[--*nbr];
+    }
+}
+
+// Serve compile requests on a local (Unix) socket at 'path', forever.
+void serverRun(char *path, ServerCompile compile) {
+    struct sockaddr_un addr;
+    struct sigaction act;
+    struct pollfd polls[2];
+    ServerJob *jobs;
+    int listener, nbr, avail;
+
+    if (!serverAddr(path, &addr))
+        errorExit(ExitOpts, "Error: Server socket path is too long: %s", path);
+    unlink(path);
+    if ((listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+        || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || listen(listener, 64) != 0)
+        errorExit(ExitError, "Error: Could not listen on %s", path);
+
+    // Finished compiles wake the server, to reply to their clients
+    if (pipe(serverWake) != 0)
+        errorExit(ExitError, "Error: Could not start the compile server");
+    fcntl(serverWake[0], F_SETFL, O_NONBLOCK);
+    fcntl(serverWake[1], F_SETFL, O_NONBLOCK);
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = serverChildDone;
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &act, NULL);
+    fprintf(stderr, "Compile server listening on %s\n", path);
+
+    avail = 16;
+    nbr = 0;
+    if ((jobs = (ServerJob *)malloc(avail * sizeof(ServerJob))) == NULL)
+        errorExit(ExitMem, "Error: Out of memory");
+    polls[0].fd = listener;
+    polls[0].events = POLLIN;
+    polls[1].fd = serverWake[0];
+    polls[1].events = POLLIN;
+    for (;;) {
+        pid_t pid;
+        int sock;
+
+        if (poll(polls, 2, -1) < 0)
+            continue;
+        if (polls[1].revents)
+            serverReap(jobs, &nbr);
+        if (!polls[0].revents || (sock = accept(listener, NULL, NULL)) < 0)
+            continue;
+
+        // Make sure buffered output is not duplicated into the compile
+        fflush(stdout);
+        fflush(stderr);
+        if ((pid = fork()) == 0) {
+            close(listener);
+            close(serverWake[0]);
+            close(serverWake[1]);
+            signal(SIGCHLD, SIG_DFL);
+            serverHandle(sock, compile);
+            _exit(ExitError);
+        }
+        if (pid < 0) {
+            close(sock);
+            continue;
+        }
+        if (nbr == avail && (jobs = (ServerJob *)realloc(jobs, (avail <<= 1) * sizeof(ServerJob))) == NULL)
+            errorExit(ExitMem, "Error: Out of memory");
+        jobs[nbr].pid = pid;
+        jobs[nbr++].sock = sock;
+    }
+}
+
+#else
+
+// Windows has no fork() or Unix sockets (as used here)
+void serverRun(char *path, ServerCompile compile) {
+    errorExit(ExitOpts, "Error: The compile server is not supported on Windows");
+}
+
+#endif
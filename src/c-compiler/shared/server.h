@@ -0,0 +1,33 @@
+/** Persistent compile server
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef server_h
+#define server_h
+
+#include <stddef.h>
+
+// Run one compile, given its command line. Returns the compiler's exit code.
+typedef int (*ServerCompile)(int argc, char **argv);
+
+// Serve compile requests on a local (Unix) socket at 'path', forever.
+// Each request is compiled in a forked copy of the server's current (warm) state.
+void serverRun(char *path, ServerCompile compile);
+
+// Hand a compile over to the server listening at 'path' (see serverclient.c).
+// Returns 0 if no server could be reached (so compile locally instead).
+// Otherwise returns 1, setting status to the compile's exit code.
+int serverRequest(char *path, int argc, char **argv, int *status);
+
+// Socket helpers shared by the server and its clients.
+// Fill in the socket address for a path (returning 0 if too long),
+// and write or read exactly size bytes (returning 0 on failure).
+struct sockaddr_un;
+int serverAddr(char *path, struct sockaddr_un *addr);
+int serverWrite(int fd, char *buf, size_t size);
+int serverRead(int fd, char *buf, size_t size);
+
+#endif
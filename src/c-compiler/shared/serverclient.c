@@ -0,0 +1,146 @@
+/** Compile server client
+ * @file
+ *
+ * The client's half of the compile server (see server.c): hand a compile over
+ * to a server, passing along the working directory, command line, stdout and
+ * stderr, then wait for the compile's exit code. It needs nothing else of the
+ * compiler, so conecc can make requests without loading LLVM.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "server.h"
+#include "error.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Fill in the socket address for a path. Returns 0 if the path is too long.
+int serverAddr(char *path, struct sockaddr_un *addr) {
+    if (strlen(path) >= sizeof(addr->sun_path))
+        return 0;
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return 1;
+}
+
+// Write all of a buffer to a socket
+int serverWrite(int fd, char *buf, size_t size) {
+    while (size) {
+        ssize_t cnt = write(fd, buf, size);
+        if (cnt < 0 && errno == EINTR)
+            continue;
+        if (cnt <= 0)
+            return 0;
+        buf += cnt;
+        size -= cnt;
+    }
+    return 1;
+}
+
+// Read exactly size bytes from a socket
+int serverRead(int fd, char *buf, size_t size) {
+    while (size) {
+        ssize_t cnt = read(fd, buf, size);
+        if (cnt < 0 && errno == EINTR)
+            continue;
+        if (cnt <= 0)
+            return 0;
+        buf += cnt;
+        size -= cnt;
+    }
+    return 1;
+}
+
+// Send the request's size, along with the client's stdout and stderr
+static int serverSendHeader(int sock, uint32_t size) {
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    int fds[2] = { 1, 2 };
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &size;
+    iov.iov_len = sizeof(size);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    return sendmsg(sock, &msg, 0) == sizeof(size);
+}
+
+// Hand a compile over to the server listening at 'path'.
+int serverRequest(char *path, int argc, char **argv, int *status) {
+    struct sockaddr_un addr;
+    char cwd[4096];
+    char *request, *reqp;
+    size_t size;
+    int sock, i;
+
+    if (!serverAddr(path, &addr) || !getcwd(cwd, sizeof(cwd)))
+        return 0;
+    if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return 0;
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(sock);
+        return 0;
+    }
+
+    // Build the request: working directory, then each argument
+    size = strlen(cwd) + 1;
+    for (i = 0; i < argc; ++i)
+        size += strlen(argv[i]) + 1;
+    reqp = request = (char *)malloc(size);
+    strcpy(reqp, cwd);
+    reqp += strlen(reqp) + 1;
+    for (i = 0; i < argc; ++i) {
+        strcpy(reqp, argv[i]);
+        reqp += strlen(reqp) + 1;
+    }
+
+    // If the server won't take the request, compile locally instead.
+    // Once it has, it owns the compile, even if it fails.
+    fflush(stdout);
+    fflush(stderr);
+    if (!serverSendHeader(sock, (uint32_t)size) || !serverWrite(sock, request, size)) {
+        close(sock);
+        free(request);
+        return 0;
+    }
+    free(request);
+    if (!serverRead(sock, (char *)status, sizeof(*status))) {
+        fprintf(stderr, "Error: Compile server %s did not finish the compile\n", path);
+        *status = ExitError;
+    }
+    close(sock);
+    return 1;
+}
+
+#else
+
+// Windows has no Unix sockets (as used here)
+int serverRequest(char *path, int argc, char **argv, int *status) {
+    return 0;
+}
+
+#endif
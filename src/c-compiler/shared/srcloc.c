@@ -0,0 +1,141 @@
+/** Source locations
+ * @file
+ *
+ * Every IR node records where in the source it came from, for error messages
+ * and debug info. Rather than keep a lexer, token, line and line number on
+ * every node, all source text is laid end to end in one 32-bit address space.
+ * A node then needs only a 32-bit source location: its token's offset there.
+ *
+ * Source locations are decoded to a file, line and column only when needed,
+ * which is rare: when reporting an error or generating debug info.
+ * A file's line table is built the first time one of its locations is decoded.
+ *
+ * Threads lexing files in parallel may add files at the same time, so adding takes
+ * a lock. Decoding takes none, as nothing decodes while files are parsed in parallel:
+ * errors found then are logged with their source location, and only decoded once
+ * parsing is done and the logs are replayed.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "srcloc.h"
+#include "memory.h"
+#include "error.h"
+
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// A lock held briefly while adding a file
+#ifdef _MSC_VER
+#define srclocLock() while (InterlockedExchange(&gSrcFilesLock, 1)) YieldProcessor()
+#define srclocUnlock() InterlockedExchange(&gSrcFilesLock, 0)
+static volatile LONG gSrcFilesLock = 0;
+#else
+#define srclocLock() while (__atomic_exchange_n(&gSrcFilesLock, 1, __ATOMIC_ACQUIRE))
+#define srclocUnlock() __atomic_store_n(&gSrcFilesLock, 0, __ATOMIC_RELEASE)
+static int gSrcFilesLock = 0;
+#endif
+
+static SrcFile **gSrcFiles = NULL;    // All source files, in order of their source locations
+static uint32_t gSrcFilesUsed = 0;
+static uint32_t gSrcFilesAvail = 0;
+static uint32_t gSrcLocNext = 0;    // Source location for the next file's first byte
+
+// Add a source file, returning the source location of its first byte
+uint32_t srclocAddFile(char *url, char *fname, char *source) {
+    SrcFile *file = (SrcFile *)memAllocBlk(sizeof(SrcFile));
+    size_t size = strlen(source);
+    uint32_t base;
+
+    srclocLock();
+    if (size >= (uint32_t)~0 - gSrcLocNext)
+        errorExit(ExitMem, "Error: Source files are too big (over 4GB in total)");
+    if (gSrcFilesUsed == gSrcFilesAvail) {
+        SrcFile **oldfiles = gSrcFiles;
+        gSrcFilesAvail = gSrcFilesAvail == 0 ? 64 : gSrcFilesAvail << 1;
+        gSrcFiles = (SrcFile **)memAllocBlk(gSrcFilesAvail * sizeof(SrcFile *));
+        memcpy(gSrcFiles, oldfiles, gSrcFilesUsed * sizeof(SrcFile *));
+        memFreeBlk(oldfiles, gSrcFilesUsed * sizeof(SrcFile *));
+    }
+
+    file->url = url;
+    file->fname = fname;
+    file->source = source;
+    file->base = base = gSrcLocNext;
+    file->size = (uint32_t)size;
+    file->lines = NULL;
+    file->nlines = 0;
+    gSrcFiles[gSrcFilesUsed++] = file;
+    gSrcLocNext += (uint32_t)size + 1;    // Leave room for the 0 terminator (end of file)
+    srclocUnlock();
+    return base;
+}
+
+// Return the source file a source location belongs to
+SrcFile *srclocFile(uint32_t loc) {
+    uint32_t low = 0;
+    uint32_t high = gSrcFilesUsed;
+
+    // Find the last file that begins at or before loc
+    while (high - low > 1) {
+        uint32_t mid = (low + high) >> 1;
+        if (gSrcFiles[mid]->base <= loc)
+            low = mid;
+        else
+            high = mid;
+    }
+    return gSrcFiles[low];
+}
+
+// Return a pointer to the source text at a source location
+char *srclocPtr(uint32_t loc) {
+    SrcFile *file = srclocFile(loc);
+    return file->source + (loc - file->base);
+}
+
+// Build a file's table of where each line starts
+static void srclocLines(SrcFile *file) {
+    char *srcp;
+    uint32_t nlines = 1;
+    uint32_t *linesp;
+
+    for (srcp = file->source; *srcp; ++srcp) {
+        if (*srcp == '\n')
+            ++nlines;
+    }
+    linesp = file->lines = (uint32_t *)memAllocBlk(nlines * sizeof(uint32_t));
+    *linesp++ = 0;
+    for (srcp = file->source; *srcp; ++srcp) {
+        if (*srcp == '\n')
+            *linesp++ = (uint32_t)(srcp + 1 - file->source);
+    }
+    file->nlines = nlines;
+}
+
+// Return the line number (starting with 1) of a source location.
+// If not NULL, also return a pointer to where its line starts.
+uint32_t srclocLine(uint32_t loc, char **linep) {
+    SrcFile *file = srclocFile(loc);
+    uint32_t offset = loc - file->base;
+    uint32_t low = 0;
+    uint32_t high;
+
+    if (file->lines == NULL)
+        srclocLines(file);
+
+    // Find the last line that begins at or before offset
+    high = file->nlines;
+    while (high - low > 1) {
+        uint32_t mid = (low + high) >> 1;
+        if (file->lines[mid] <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+    if (linep)
+        *linep = file->source + file->lines[low];
+    return low + 1;
+}
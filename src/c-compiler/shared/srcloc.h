@@ -0,0 +1,38 @@
+/** Source locations
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef srcloc_h
+#define srcloc_h
+
+#include <stdint.h>
+
+// A source file, whose text occupies a range of source locations
+typedef struct SrcFile {
+    char *url;        // The url where the source text came from
+    char *fname;    // The filename of the url (no extension)
+    char *source;    // The source text (0-terminated)
+    uint32_t base;    // Source location of the source text's first byte
+    uint32_t size;    // Size of the source text
+    uint32_t *lines;    // Offset where each line starts (built on first use)
+    uint32_t nlines;    // Number of lines
+} SrcFile;
+
+// Add a source file, returning the source location of its first byte.
+// Its locations run from there through the end of its text (and its 0 terminator).
+uint32_t srclocAddFile(char *url, char *fname, char *source);
+
+// Return the source file a source location belongs to
+SrcFile *srclocFile(uint32_t loc);
+
+// Return a pointer to the source text at a source location
+char *srclocPtr(uint32_t loc);
+
+// Return the line number (starting with 1) of a source location.
+// If not NULL, also return a pointer to where its line starts.
+uint32_t srclocLine(uint32_t loc, char **linep);
+
+#endif
@@ -0,0 +1,170 @@
+/** Compiler statistics (--stats)
+ * @file
+ *
+ * For every compiler phase, this measures elapsed (wall) time, CPU time, and the
+ * change in live arena memory. Only one phase is current at a time: switching phases
+ * charges everything since the last switch to the phase being left.
+ * Along the way, it counts tokens, interned names, IR nodes and LLVM instructions.
+ *
+ * The report is printed readably, and may also be written as JSON, so that
+ * compile-time regressions can be tracked phase by phase.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "stats.h"
+#include "memory.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+int statsOn = 0;
+size_t statsTokens = 0;
+size_t statsLlvmInstrs = 0;
+size_t statsLlvmOptInstrs = 0;
+size_t statsNodes[512];
+
+// Number of interned names (ir/nametbl.c) and tag names (ir/inode.c)
+size_t nametblUsed();
+char *inodeTagName(uint16_t tag);
+
+// What has been measured for each phase
+typedef struct StatsTally {
+    double wall;    // Elapsed seconds
+    double cpu;        // CPU seconds
+    long long mem;    // Live arena bytes added (negative if more were freed)
+} StatsTally;
+
+static StatsTally statsTally[StatsNbrPhases];
+static int statsCurPhase;
+static double statsWallMark;
+static clock_t statsCpuMark;
+static long long statsMemMark;
+
+static char *statsPhaseNames[StatsNbrPhases] = {
+    "setup", "lex", "parse", "nameres", "typecheck", "flow", "gen", "optimize", "emit"
+};
+
+// Elapsed seconds since some fixed point in time
+double statsWallClock() {
+#ifdef _WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+// Turn on measuring, starting with the setup phase
+void statsInit() {
+    statsOn = 1;
+    memset(statsTally, 0, sizeof(statsTally));
+    memset(statsNodes, 0, sizeof(statsNodes));
+    statsCurPhase = StatsSetup;
+    statsWallMark = statsWallClock();
+    statsCpuMark = clock();
+    statsMemMark = (long long)memUsed(NULL, NULL);
+}
+
+// Switch to measuring a new phase, returning the phase that was being measured.
+int statsPhase(int phase) {
+    int oldphase = statsCurPhase;
+    double wall;
+    clock_t cpu;
+    long long mem;
+
+    if (!statsOn)
+        return phase;
+    wall = statsWallClock();
+    cpu = clock();
+    mem = (long long)memUsed(NULL, NULL);
+    statsTally[oldphase].wall += wall - statsWallMark;
+    statsTally[oldphase].cpu += (double)(cpu - statsCpuMark) / CLOCKS_PER_SEC;
+    statsTally[oldphase].mem += mem - statsMemMark;
+    statsWallMark = wall;
+    statsCpuMark = cpu;
+    statsMemMark = mem;
+    statsCurPhase = phase;
+    return oldphase;
+}
+
+// Write the report as JSON
+static void statsJson(FILE *file, StatsTally *total, size_t live, size_t peak, size_t wasted) {
+    int i;
+    int first = 1;
+    fprintf(file, "{\n  \"phases\": {\n");
+    for (i = 0; i < StatsNbrPhases; ++i)
+        fprintf(file, "    \"%s\": { \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"arena_bytes\": %lld }%s\n",
+            statsPhaseNames[i], statsTally[i].wall * 1000., statsTally[i].cpu * 1000.,
+            statsTally[i].mem, i + 1 < StatsNbrPhases ? "," : "");
+    fprintf(file, "  },\n  \"total\": { \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"arena_bytes\": %lld },\n",
+        total->wall * 1000., total->cpu * 1000., total->mem);
+    fprintf(file, "  \"memory\": { \"live_bytes\": %lu, \"peak_bytes\": %lu, \"wasted_bytes\": %lu },\n",
+        (unsigned long)live, (unsigned long)peak, (unsigned long)wasted);
+    fprintf(file, "  \"tokens\": %lu,\n  \"names\": %lu,\n", (unsigned long)statsTokens, (unsigned long)nametblUsed());
+    fprintf(file, "  \"llvm_instructions\": %lu,\n  \"llvm_instructions_optimized\": %lu,\n",
+        (unsigned long)statsLlvmInstrs, (unsigned long)statsLlvmOptInstrs);
+    fprintf(file, "  \"nodes\": {");
+    for (i = 0; i < 512; ++i) {
+        if (statsNodes[i] == 0)
+            continue;
+        fprintf(file, "%s\n    \"%s\": %lu", first ? "" : ",",
+            inodeTagName((uint16_t)(((i >> 5) << 12) | (i & 0x1F))), (unsigned long)statsNodes[i]);
+        first = 0;
+    }
+    fprintf(file, "\n  }\n}\n");
+}
+
+// Print the report to stderr, and as JSON to the file at jsonpath ("-" for stdout), if not NULL
+void statsReport(char *jsonpath) {
+    StatsTally total;
+    size_t nodes = 0;
+    size_t live, peak, wasted;
+    int i;
+
+    if (!statsOn)
+        return;
+    statsPhase(statsCurPhase);
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < StatsNbrPhases; ++i) {
+        total.wall += statsTally[i].wall;
+        total.cpu += statsTally[i].cpu;
+        total.mem += statsTally[i].mem;
+    }
+    for (i = 0; i < 512; ++i)
+        nodes += statsNodes[i];
+    live = memUsed(&peak, &wasted);
+
+    fprintf(stderr, "%-12s %10s %10s %12s\n", "Phase", "Wall ms", "CPU ms", "Arena kb");
+    for (i = 0; i < StatsNbrPhases; ++i)
+        fprintf(stderr, "%-12s %10.3f %10.3f %12lld\n", statsPhaseNames[i],
+            statsTally[i].wall * 1000., statsTally[i].cpu * 1000., statsTally[i].mem / 1024);
+    fprintf(stderr, "%-12s %10.3f %10.3f %12lld\n", "total",
+        total.wall * 1000., total.cpu * 1000., total.mem / 1024);
+    fprintf(stderr, "Memory: %lu kb live, %lu kb peak, %lu kb wasted\n",
+        (unsigned long)live / 1024, (unsigned long)peak / 1024, (unsigned long)wasted / 1024);
+    fprintf(stderr, "%lu tokens, %lu names, %lu IR nodes, %lu LLVM instructions (%lu optimized)\n",
+        (unsigned long)statsTokens, (unsigned long)nametblUsed(), (unsigned long)nodes,
+        (unsigned long)statsLlvmInstrs, (unsigned long)statsLlvmOptInstrs);
+
+    if (jsonpath) {
+        FILE *file = strcmp(jsonpath, "-") == 0 ? stdout : fopen(jsonpath, "w");
+        if (file == NULL) {
+            fprintf(stderr, "Error: Could not write stats to %s\n", jsonpath);
+            return;
+        }
+        statsJson(file, &total, live, peak, wasted);
+        if (file != stdout)
+            fclose(file);
+    }
+}
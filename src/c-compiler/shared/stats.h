@@ -0,0 +1,57 @@
+/** Compiler statistics (--stats)
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef stats_h
+#define stats_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The compiler phases whose time and memory use are measured
+enum StatsPhases {
+    StatsSetup,        // Options, target machine, name table and std library
+    StatsLex,        // Loading source files and scanning tokens
+    StatsParse,        // Building the IR (excluding lexing)
+    StatsNameRes,    // NameResolution pass
+    StatsTypeCheck,    // TypeCheck pass (excluding data flow)
+    StatsFlow,        // Data flow pass
+    StatsGen,        // Generating LLVM IR (and running function passes on it)
+    StatsOptimize,    // Module optimization passes
+    StatsEmit,        // Emitting object (and assembly) files
+    StatsNbrPhases
+};
+
+// Is --stats on? When off, nothing is measured
+extern int statsOn;
+
+// Counters, only maintained when statsOn
+extern size_t statsTokens;            // Tokens scanned
+extern size_t statsLlvmInstrs;        // LLVM instructions generated
+extern size_t statsLlvmOptInstrs;    // LLVM instructions after optimization
+extern size_t statsNodes[512];        // IR nodes created, by tag (see statsNodeIdx)
+
+// Map a node's tag to its index in statsNodes: its group/named/method bits, then its number
+#define statsNodeIdx(tag) ((((tag) >> 12) << 5) | ((tag) & 0x1F))
+
+// Count a newly created IR node
+#define statsCountNode(tag) (statsOn ? (void)++statsNodes[statsNodeIdx(tag)] : (void)0)
+
+// Elapsed seconds since some fixed point in time
+double statsWallClock();
+
+// Turn on measuring, starting with the setup phase
+void statsInit();
+
+// Switch to measuring a new phase, returning the phase that was being measured.
+// Time and memory are charged to whichever phase is current, so a phase that
+// nests inside another (e.g., lexing within parsing) is excluded from it.
+int statsPhase(int phase);
+
+// Print the report to stderr, and as JSON to the file at jsonpath ("-" for stdout), if not NULL
+void statsReport(char *jsonpath);
+
+#endif
@@ -0,0 +1,88 @@
+/** Timeline of compilation, as a Chrome trace-event file (--time-trace)
+ * @file
+ *
+ * Spans of work (an included file, a semantic pass over a function, generating
+ * a function, an LLVM pass pipeline, ...) are written as they begin and end,
+ * as "B" and "E" trace events. The file can be opened in chrome://tracing or
+ * the Perfetto UI, to see which functions or files are slow to compile.
+ *
+ * Work done by forked jobs (e.g., --jobs or --units) is not traced:
+ * its span in the parent covers all the jobs.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "trace.h"
+#include "stats.h"
+
+#include <stdio.h>
+
+int traceOn = 0;
+
+static FILE *traceFile;
+static double traceStart;    // When the trace began, in seconds
+static int traceDepth;        // Number of spans still open
+
+// Microseconds since the trace began
+static double traceTime() {
+    return (statsWallClock() - traceStart) * 1e6;
+}
+
+// Write a string as a JSON string literal
+static void traceStr(char *str) {
+    fputc('"', traceFile);
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\')
+            fprintf(traceFile, "\\%c", *str);
+        else if ((unsigned char)*str < ' ')
+            fprintf(traceFile, "\\u%04x", *str);
+        else
+            fputc(*str, traceFile);
+    }
+    fputc('"', traceFile);
+}
+
+// Start writing the trace to the file at path
+void traceInit(char *path) {
+    if (!(traceFile = fopen(path, "w"))) {
+        fprintf(stderr, "Error: Could not create time trace file %s\n", path);
+        return;
+    }
+    traceOn = 1;
+    traceStart = statsWallClock();
+    traceDepth = 0;
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", traceFile);
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"conec\"}}", traceFile);
+}
+
+// Begin a span of work, in a category (e.g., "gen"), named for what it works on
+void traceBegin(char *cat, char *name) {
+    if (!traceOn)
+        return;
+    fputs(",\n{\"name\":", traceFile);
+    traceStr(name);
+    fputs(",\"cat\":", traceFile);
+    traceStr(cat);
+    fprintf(traceFile, ",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":1}", traceTime());
+    ++traceDepth;
+}
+
+// End the most recently begun span
+void traceEnd() {
+    if (!traceOn || traceDepth == 0)
+        return;
+    fprintf(traceFile, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":1}", traceTime());
+    --traceDepth;
+}
+
+// End any spans still open, and finish the trace file
+void traceClose() {
+    if (!traceOn)
+        return;
+    while (traceDepth)
+        traceEnd();
+    fputs("\n]}\n", traceFile);
+    fclose(traceFile);
+    traceOn = 0;
+}
@@ -0,0 +1,26 @@
+/** Timeline of compilation, as a Chrome trace-event file (--time-trace)
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef trace_h
+#define trace_h
+
+// Is --time-trace on? When off, nothing is recorded
+extern int traceOn;
+
+// Start writing the trace to the file at path (reporting an error if it cannot)
+void traceInit(char *path);
+
+// Begin a span of work, in a category (e.g., "gen"), named for what it works on
+void traceBegin(char *cat, char *name);
+
+// End the most recently begun span
+void traceEnd();
+
+// End any spans still open, and finish the trace file
+void traceClose();
+
+#endif
@@ -11,46 +11,6 @@
 
 #include <string.h>
 
-Name *keyAdd(char *keyword, uint16_t toktype) {
-    Name *sym;
-    INamedNode *node;
-    sym = nametblFind(keyword, strlen(keyword));
-    sym->node = node = (INamedNode*)memAllocBlk(sizeof(INode));
-    node->tag = KeywordTag;
-    node->flags = toktype;
-    return sym;
-}
-
-void keywordInit() {
-    keyAdd("include", IncludeToken);
-    keyAdd("mod", ModToken);
-    keyAdd("extern", ExternToken);
-    keyAdd("set", SetToken);
-    keyAdd("fn", FnToken);
-    keyAdd("struct", StructToken);
-    keyAdd("alloc", AllocToken);
-    keyAdd("return", RetToken);
-    keyAdd("do", DoToken);
-    keyAdd("if", IfToken);
-    keyAdd("elif", ElifToken);
-    keyAdd("else", ElseToken);
-    keyAdd("while", WhileToken);
-    keyAdd("each", EachToken);
-    keyAdd("in", InToken);
-    keyAdd("by", ByToken);
-    keyAdd("break", BreakToken);
-    keyAdd("continue", ContinueToken);
-    keyAdd("not", NotToken);
-    keyAdd("or", OrToken);
-    keyAdd("and", AndToken);
-    keyAdd("as", AsToken);
-    keyAdd("into", IntoToken);
-
-    keyAdd("true", trueToken);
-    keyAdd("false", falseToken);
-    keyAdd("null", nullToken);
-}
-
 PermNode *newPermNodeStr(char *name, uint16_t flags) {
     Name *namesym = nametblFind(name, strlen(name));
     PermNode *perm = newPermDclNode(namesym, flags);
@@ -130,7 +90,6 @@ void stdlibInit(int ptrsize) {
 
     voidType = (INode*)newVoidNode();
 
-    keywordInit();
     stdPermInit();
     stdAllocInit();
     stdNbrInit(ptrsize);
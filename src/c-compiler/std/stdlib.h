@@ -86,7 +86,6 @@ IMethodNode *refType;
 IMethodNode *arrayRefType;
 
 void stdlibInit(int ptrsize);
-void keywordInit();
 void stdNbrInit(int ptrsize);
 
 #endif